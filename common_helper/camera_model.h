@@ -24,6 +24,7 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <algorithm>
 
 #include <opencv2/opencv.hpp>
 #ifdef _OPENMP
@@ -211,10 +212,7 @@ public:
     /*** Methods for projection ***/
     void ConvertWorld2Image(const cv::Point3f& object_point, cv::Point2f& image_point)
     {
-        std::vector<cv::Point3f> object_point_list = { object_point };
-        std::vector<cv::Point2f> image_point_list;
-        ConvertWorld2Image(object_point_list, image_point_list);
-        image_point = image_point_list[0];
+        ConvertWorld2Image(&object_point.x, 1, &image_point.x);
     }
 
     void ConvertWorld2Image(const std::vector<cv::Point3f>& object_point_list, std::vector<cv::Point2f>& image_point_list)
@@ -222,120 +220,171 @@ public:
         /*** Mw -> Image ***/
         /* the followings get exactly the same result */
 #if 1
+        image_point_list.resize(object_point_list.size());
+        if (object_point_list.empty()) return;
+        ConvertWorld2Image(&object_point_list[0].x, static_cast<int32_t>(object_point_list.size()), &image_point_list[0].x);
+#else
+        cv::projectPoints(object_point_list, this->rvec, this->tvec, this->K, this->dist_coeff, image_point_list);
+#endif
+    }
+
+    void ConvertWorld2Camera(const std::vector<cv::Point3f>& object_point_in_world_list, std::vector<cv::Point3f>& object_point_in_camera_list)
+    {
+        object_point_in_camera_list.resize(object_point_in_world_list.size());
+        if (object_point_in_world_list.empty()) return;
+        ConvertWorld2Camera(&object_point_in_world_list[0].x, static_cast<int32_t>(object_point_in_world_list.size()), &object_point_in_camera_list[0].x);
+    }
+
+    void ConvertCamera2World(const std::vector<cv::Point3f>& object_point_in_camera_list, std::vector<cv::Point3f>& object_point_in_world_list)
+    {
+        object_point_in_world_list.resize(object_point_in_camera_list.size());
+        if (object_point_in_camera_list.empty()) return;
+        ConvertCamera2World(&object_point_in_camera_list[0].x, static_cast<int32_t>(object_point_in_camera_list.size()), &object_point_in_world_list[0].x);
+    }
+
+    /*** Batch kernels for contiguous arrays ***/
+    /* object_point = [x0, y0, z0, x1, y1, z1, ...], image_point = [x0, y0, x1, y1, ...]. No allocation in the loop */
+    /* The same layout as std::vector<cv::Point3f> / std::vector<cv::Point2f>, so their data can be passed directly */
+    void ConvertWorld2Image(const float* object_point, int32_t num, float* image_point)
+    {
         /*** Projection ***/
         /* s[x, y, 1] = K * [R t] * [M, 1] = K * M_from_cam */
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat Rt = (cv::Mat_<float>(3, 4) <<
-            R.at<float>(0), R.at<float>(1), R.at<float>(2), this->tx(),
-            R.at<float>(3), R.at<float>(4), R.at<float>(5), this->ty(),
-            R.at<float>(6), R.at<float>(7), R.at<float>(8), this->tz());
-
-        image_point_list.resize(object_point_list.size());
+        UpdateProjectionCache();
+        const float* Rt = this->cache_.Rt.data();
+        const float fx = this->cache_.K[0];
+        const float cx = this->cache_.K[2];
+        const float fy = this->cache_.K[4];
+        const float cy = this->cache_.K[5];
+        const bool is_distorted = !(this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0);
+        const float k1 = is_distorted ? this->dist_coeff.at<float>(0) : 0;
+        const float k2 = is_distorted ? this->dist_coeff.at<float>(1) : 0;
+        const float p1 = is_distorted ? this->dist_coeff.at<float>(3) : 0;
+        const float p2 = is_distorted ? this->dist_coeff.at<float>(4) : 0;
 
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
-            const auto& object_point = object_point_list[i];
-            auto& image_point = image_point_list[i];
-            cv::Mat Mw = (cv::Mat_<float>(4, 1) << object_point.x, object_point.y, object_point.z, 1);
-            cv::Mat Mc = Rt * Mw;
-            float Zc = Mc.at<float>(2);
+        for (int32_t i = 0; i < num; i++) {
+            const float Xw = object_point[i * 3 + 0];
+            const float Yw = object_point[i * 3 + 1];
+            const float Zw = object_point[i * 3 + 2];
+            const float Xc = Rt[0] * Xw + Rt[1] * Yw + Rt[2] * Zw + Rt[3];
+            const float Yc = Rt[4] * Xw + Rt[5] * Yw + Rt[6] * Zw + Rt[7];
+            const float Zc = Rt[8] * Xw + Rt[9] * Yw + Rt[10] * Zw + Rt[11];
             if (Zc <= 0) {
                 /* Do not project points behind the camera */
-                image_point = cv::Point2f(-1, -1);
+                image_point[i * 2 + 0] = -1;
+                image_point[i * 2 + 1] = -1;
                 continue;
             }
 
-            cv::Mat XY = K * Mc;
-            float x = XY.at<float>(0);
-            float y = XY.at<float>(1);
-            float s = XY.at<float>(2);
-            x /= s;
-            y /= s;
-
-            if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-                image_point.x = x;
-                image_point.y = y;
-            } else {
+            /* K is [fx 0 cx; 0 fy cy; 0 0 1], so (x, y) = (fx * Xc / Zc + cx, fy * Yc / Zc + cy) */
+            float u = Xc / Zc;  /* from optical center*/
+            float v = Yc / Zc;  /* from optical center*/
+            if (is_distorted) {
                 /*** Distort ***/
-                float u = (x - this->cx()) / this->fx();  /* from optical center*/
-                float v = (y - this->cy()) / this->fy();  /* from optical center*/
                 float r2 = u * u + v * v;
                 float r4 = r2 * r2;
-                float k1 = this->dist_coeff.at<float>(0);
-                float k2 = this->dist_coeff.at<float>(1);
-                float p1 = this->dist_coeff.at<float>(3);
-                float p2 = this->dist_coeff.at<float>(4);
                 u = u + u * (k1 * r2 + k2 * r4 /*+ k3 * r6 */) + (2 * p1 * u * v) + p2 * (r2 + 2 * u * u);
                 v = v + v * (k1 * r2 + k2 * r4 /*+ k3 * r6 */) + (2 * p2 * u * v) + p1 * (r2 + 2 * v * v);
-                image_point.x = u * this->fx() + this->cx();
-                image_point.y = v * this->fy() + this->cy();
             }
+            image_point[i * 2 + 0] = u * fx + cx;
+            image_point[i * 2 + 1] = v * fy + cy;
         }
-#else
-        cv::projectPoints(object_point_list, this->rvec, this->tvec, this->K, this->dist_coeff, image_point_list);
-#endif
     }
 
-    void ConvertWorld2Camera(const std::vector<cv::Point3f>& object_point_in_world_list, std::vector<cv::Point3f>& object_point_in_camera_list)
+    void ConvertWorld2Camera(const float* object_point_in_world, int32_t num, float* object_point_in_camera)
     {
         /*** Mw -> Mc ***/
         /* Mc = [R t] * [M, 1] */
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat Rt = (cv::Mat_<float>(3, 4) <<
-            R.at<float>(0), R.at<float>(1), R.at<float>(2), this->tx(),
-            R.at<float>(3), R.at<float>(4), R.at<float>(5), this->ty(),
-            R.at<float>(6), R.at<float>(7), R.at<float>(8), this->tz());
-
-        object_point_in_camera_list.resize(object_point_in_world_list.size());
+        UpdateProjectionCache();
+        const float* Rt = this->cache_.Rt.data();
 
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-        for (int32_t i = 0; i < object_point_in_world_list.size(); i++) {
-            const auto& object_point_in_world = object_point_in_world_list[i];
-            auto& object_point_in_camera = object_point_in_camera_list[i];
-            cv::Mat Mw = (cv::Mat_<float>(4, 1) << object_point_in_world.x, object_point_in_world.y, object_point_in_world.z, 1);
-            cv::Mat Mc = Rt * Mw;
-            object_point_in_camera.x = Mc.at<float>(0);
-            object_point_in_camera.y = Mc.at<float>(1);
-            object_point_in_camera.z = Mc.at<float>(2);
+        for (int32_t i = 0; i < num; i++) {
+            const float Xw = object_point_in_world[i * 3 + 0];
+            const float Yw = object_point_in_world[i * 3 + 1];
+            const float Zw = object_point_in_world[i * 3 + 2];
+            object_point_in_camera[i * 3 + 0] = Rt[0] * Xw + Rt[1] * Yw + Rt[2] * Zw + Rt[3];
+            object_point_in_camera[i * 3 + 1] = Rt[4] * Xw + Rt[5] * Yw + Rt[6] * Zw + Rt[7];
+            object_point_in_camera[i * 3 + 2] = Rt[8] * Xw + Rt[9] * Yw + Rt[10] * Zw + Rt[11];
         }
     }
 
-    void ConvertCamera2World(const std::vector<cv::Point3f>& object_point_in_camera_list, std::vector<cv::Point3f>& object_point_in_world_list)
+    void ConvertCamera2World(const float* object_point_in_camera, int32_t num, float* object_point_in_world)
     {
         /*** Mc -> Mw ***/
         /* Mc = [R t] * [Mw, 1] */
         /* -> [M, 1] = [R t]^1 * Mc <- Unable to get the inverse of [R t] because it's 4x3 */
         /* So, Mc = R * Mw + t */
-        /* -> Mw = R^1 * (Mc - t) */
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat R_inv;
-        cv::invert(R, R_inv);
-        cv::Mat t = this->tvec;
-
-
-        object_point_in_world_list.resize(object_point_in_camera_list.size());
+        /* -> Mw = R^1 * (Mc - t) = R^1 * Mc - R^1 * t */
+        UpdateProjectionCache();
+        const float* R_inv = this->cache_.R_inv.data();
+        const float* R_inv_t = this->cache_.R_inv_t.data();
 
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-        for (int32_t i = 0; i < object_point_in_camera_list.size(); i++) {
-            const auto& object_point_in_camera = object_point_in_camera_list[i];
-            auto& object_point_in_world = object_point_in_world_list[i];
-            cv::Mat Mc = (cv::Mat_<float>(3, 1) << object_point_in_camera.x, object_point_in_camera.y, object_point_in_camera.z);
-            cv::Mat Mw = R_inv * (Mc - t);
-            object_point_in_world.x = Mw.at<float>(0);
-            object_point_in_world.y = Mw.at<float>(1);
-            object_point_in_world.z = Mw.at<float>(2);
+        for (int32_t i = 0; i < num; i++) {
+            const float Xc = object_point_in_camera[i * 3 + 0];
+            const float Yc = object_point_in_camera[i * 3 + 1];
+            const float Zc = object_point_in_camera[i * 3 + 2];
+            object_point_in_world[i * 3 + 0] = R_inv[0] * Xc + R_inv[1] * Yc + R_inv[2] * Zc - R_inv_t[0];
+            object_point_in_world[i * 3 + 1] = R_inv[3] * Xc + R_inv[4] * Yc + R_inv[5] * Zc - R_inv_t[1];
+            object_point_in_world[i * 3 + 2] = R_inv[6] * Xc + R_inv[7] * Yc + R_inv[8] * Zc - R_inv_t[2];
         }
     }
 
+    /*** Cache of matrices for projection ***/
+    /* Parameters can be modified directly through the accessors (rx(), tx(), etc.) */
+    /* So, the cache is validated by comparing the parameters it was built from, instead of updating it in each setter */
+    void UpdateProjectionCache()
+    {
+        const float* r = this->rvec.ptr<float>();
+        const float* t = this->tvec.ptr<float>();
+        const float* k = this->K.ptr<float>();
+        if (this->cache_.is_valid
+            && std::equal(r, r + 3, this->cache_.rvec.begin()) && std::equal(t, t + 3, this->cache_.tvec.begin()) && std::equal(k, k + 9, this->cache_.K.begin())) {
+            return;
+        }
+        std::copy(r, r + 3, this->cache_.rvec.begin());
+        std::copy(t, t + 3, this->cache_.tvec.begin());
+        std::copy(k, k + 9, this->cache_.K.begin());
+
+        cv::Mat R = MakeRotationMat(Rad2Deg(r[0]), Rad2Deg(r[1]), Rad2Deg(r[2]));
+        cv::Mat R_inv;
+        cv::invert(R, R_inv);
+        for (int32_t i = 0; i < 3; i++) {
+            for (int32_t j = 0; j < 3; j++) {
+                this->cache_.R[i * 3 + j] = R.at<float>(i, j);
+                this->cache_.R_inv[i * 3 + j] = R_inv.at<float>(i, j);
+                this->cache_.Rt[i * 4 + j] = R.at<float>(i, j);
+            }
+            this->cache_.Rt[i * 4 + 3] = t[i];
+        }
+        for (int32_t i = 0; i < 3; i++) {
+            this->cache_.R_inv_t[i] = this->cache_.R_inv[i * 3 + 0] * t[0] + this->cache_.R_inv[i * 3 + 1] * t[1] + this->cache_.R_inv[i * 3 + 2] * t[2];
+        }
+        cv::Mat K_inv;
+        cv::invert(this->K, K_inv);
+        cv::Mat R_inv_K_inv = R_inv * K_inv;
+        for (int32_t i = 0; i < 9; i++) {
+            this->cache_.R_inv_K_inv[i] = R_inv_K_inv.at<float>(i);
+        }
+        this->cache_.vanishment_y = EstimateVanishmentY();
+        this->cache_.is_valid = true;
+    }
+
     void ConvertImage2GroundPlane(const std::vector<cv::Point2f>& image_point_list, std::vector<cv::Point3f>& object_point_list)
+    {
+        if (image_point_list.size() == 0) return;
+        object_point_list.resize(image_point_list.size());
+        ConvertImage2GroundPlane(&image_point_list[0].x, static_cast<int32_t>(image_point_list.size()), &object_point_list[0].x);
+    }
+
+    void ConvertImage2GroundPlane(const float* image_point, int32_t num, float* object_point)
     {
         /*** Image -> Mw ***/
         /*** Calculate point in ground plane (in world coordinate) ***/
@@ -349,115 +398,182 @@ public:
         /*   s * Rinv * Kinv * [x, y, 1] = M + R_inv * t */
         /*      where, M = (X, Y, Z), and we assume Y = 0(ground_plane) */
         /*      so , we can solve left[1] = R_inv * t[1](camera_height) */
+        /* then, M = s * (Rinv * Kinv * [x, y, 1]) - Rinv * t */
+        /* Rinv * Kinv, Rinv * t and the vanishing row are constant for the camera, so they are cached */
 
-        if (image_point_list.size() == 0) return;
-
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat K_inv;
-        cv::invert(K, K_inv);
-        cv::Mat R_inv;
-        cv::invert(R, R_inv);
-        cv::Mat t = this->tvec;
+        if (num <= 0) return;
+        UpdateProjectionCache();
+        const float* A = this->cache_.R_inv_K_inv.data();
+        const float* R_inv_t = this->cache_.R_inv_t.data();
+        const float vanishment_y = static_cast<float>(this->cache_.vanishment_y);
 
         /*** Undistort image point ***/
         std::vector<cv::Point2f> image_point_undistort;
-        if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-            image_point_undistort = image_point_list;
-        } else {
-            cv::undistortPoints(image_point_list, image_point_undistort, this->K, this->dist_coeff, this->K);    /* don't use K_new */
+        const float* image_point_src = image_point;
+        if (!(this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0)) {
+            cv::Mat image_point_mat(num, 1, CV_32FC2, const_cast<float*>(image_point));
+            cv::undistortPoints(image_point_mat, image_point_undistort, this->K, this->dist_coeff, this->K);    /* don't use K_new */
+            image_point_src = &image_point_undistort[0].x;
         }
 
-        object_point_list.resize(image_point_list.size());
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
-            const auto& image_point = image_point_list[i];
-            auto& object_point = object_point_list[i];
-
-            float x = image_point_undistort[i].x;
-            float y = image_point_undistort[i].y;
-            if (y < EstimateVanishmentY()) {
-                object_point.x = 999;
-                object_point.y = 999;
-                object_point.z = 999;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (int32_t i = 0; i < num; i++) {
+            const float x = image_point_src[i * 2 + 0];
+            const float y = image_point_src[i * 2 + 1];
+            float* M = object_point + i * 3;
+            if (y < vanishment_y) {
+                M[0] = 999;
+                M[1] = 999;
+                M[2] = 999;
                 continue;
             }
 
-            cv::Mat XY = (cv::Mat_<float>(3, 1) << x, y, 1);
-
             /* calculate s */
-            cv::Mat LEFT_WO_S = R_inv * K_inv * XY;
-            cv::Mat RIGHT_WO_M = R_inv * t;         /* no need to add M because M[1] = 0 (ground plane)*/
-            float s = RIGHT_WO_M.at<float>(1) / LEFT_WO_S.at<float>(1);
+            const float L0 = A[0] * x + A[1] * y + A[2];
+            const float L1 = A[3] * x + A[4] * y + A[5];
+            const float L2 = A[6] * x + A[7] * y + A[8];
+            const float s = R_inv_t[1] / L1;
 
             /* calculate M */
-            cv::Mat TEMP = R_inv * (s * K_inv * XY - t);
-
-            object_point.x = TEMP.at<float>(0);
-            object_point.y = TEMP.at<float>(1);
-            object_point.z = TEMP.at<float>(2);
-            if (object_point.z < 0) object_point.z = 999;
+            M[0] = s * L0 - R_inv_t[0];
+            M[1] = s * L1 - R_inv_t[1];
+            M[2] = s * L2 - R_inv_t[2];
+            if (M[2] < 0) M[2] = 999;
         }
     }
 
     void ConvertImage2Camera(std::vector<cv::Point2f>& image_point_list, const std::vector<float>& z_list, std::vector<cv::Point3f>& object_point_list)
     {
         /*** Image -> Mc ***/
+        /* Mc = Zc * [(x - cx) / fx, (y - cy) / fy, 1], where (x, y) is the undistorted image point */
         if (image_point_list.size() == 0) {
             /* Convert for all pixels on image, when image_point_list = empty */
-            if (z_list.size() != this->width * this->height) {
+            /* object_point_list[y * width + x] is the point of the pixel (x, y) */
+            if (z_list.size() != static_cast<size_t>(this->width) * this->height) {
                 printf("[ConvertImage2Camera] Invalid z_list size\n");
+                object_point_list.clear();
                 return;
             }
-            /* Generate the original image point mat */
-            /* todo: no need to generate every time */
+            /* image_point_list is filled with the pixel grid, as callers may use it. Use the overload for raw buffers not to generate it */
+            image_point_list.resize(z_list.size());
             for (int32_t y = 0; y < this->height; y++) {
                 for (int32_t x = 0; x < this->width; x++) {
-                    image_point_list.push_back(cv::Point2f(float(x), float(y)));
+                    image_point_list[y * this->width + x] = cv::Point2f(float(x), float(y));
                 }
             }
-        } else {
-            /* Convert for the input pixels only */
-            if (z_list.size() != image_point_list.size()) {
-                printf("[ConvertImage2Camera] Invalid z_list size\n");
-                return;
-            }
+            object_point_list.resize(z_list.size());
+            if (z_list.empty()) return;
+            ConvertImage2Camera(z_list.data(), &object_point_list[0].x);
+            return;
+        }
+
+        /* Convert for the input pixels only */
+        if (z_list.size() != image_point_list.size()) {
+            printf("[ConvertImage2Camera] Invalid z_list size\n");
+            object_point_list.clear();
+            return;
         }
 
         /*** Undistort image point ***/
         std::vector<cv::Point2f> image_point_undistort;
-        if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-            image_point_undistort = image_point_list;   /* todo: redundant copy. I do this just because to make code simple */
-        } else {
+        const bool is_distorted = !(this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0);
+        if (is_distorted) {
             cv::undistortPoints(image_point_list, image_point_undistort, this->K, this->dist_coeff, this->K);    /* don't use K_new */
         }
-
-        object_point_list.resize(image_point_list.size());
+        const std::vector<cv::Point2f>& image_point_src = is_distorted ? image_point_undistort : image_point_list;
+
+        const float fx = this->fx();
+        const float cx = this->cx();
+        const float fy = this->fy();
+        const float cy = this->cy();
+        const int32_t num = static_cast<int32_t>(image_point_list.size());
+        object_point_list.resize(num);
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
+        for (int32_t i = 0; i < num; i++) {
             const auto& Zc = z_list[i];
             auto& object_point = object_point_list[i];
+            object_point.x = Zc * (image_point_src[i].x - cx) / fx;
+            object_point.y = Zc * (image_point_src[i].y - cy) / fy;
+            object_point.z = Zc;
+        }
+    }
+
+    void ConvertImage2Camera(const float* z, float* object_point)
+    {
+        /*** Image -> Mc for all pixels on image ***/
+        /* z[y * width + x] = Zc of the pixel (x, y), object_point = [x, y, z] * (width * height) */
+        UpdateRayTable();
+        const float* ray = this->ray_table_.ray.data();
+        const int32_t num = this->width * this->height;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (int32_t i = 0; i < num; i++) {
+            const float Zc = z[i];
+            object_point[i * 3 + 0] = Zc * ray[i * 2 + 0];
+            object_point[i * 3 + 1] = Zc * ray[i * 2 + 1];
+            object_point[i * 3 + 2] = Zc;
+        }
+    }
 
-            float x = image_point_undistort[i].x;
-            float y = image_point_undistort[i].y;
+    /*** Cache of rays for all pixels ***/
+    /* ray = Mc / Zc = [(x - cx) / fx, (y - cy) / fy] of the undistorted point of each pixel */
+    /* Rebuilt only when the image size, intrinsic parameters or distortion coefficients are changed */
+    void UpdateRayTable()
+    {
+        std::array<float, 9> k;
+        std::array<float, 5> dist = { 0 };
+        std::copy(this->K.ptr<float>(), this->K.ptr<float>() + 9, k.begin());
+        const bool is_distorted = !(this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0);
+        if (is_distorted) {
+            std::copy(this->dist_coeff.ptr<float>(), this->dist_coeff.ptr<float>() + 5, dist.begin());
+        }
+        if (this->ray_table_.is_valid && this->ray_table_.width == this->width && this->ray_table_.height == this->height
+            && this->ray_table_.K == k && this->ray_table_.dist == dist) {
+            return;
+        }
+        this->ray_table_.width = this->width;
+        this->ray_table_.height = this->height;
+        this->ray_table_.K = k;
+        this->ray_table_.dist = dist;
+
+        /* Generate the original image point */
+        const int32_t num = this->width * this->height;
+        std::vector<cv::Point2f> image_point_list(num);
+        for (int32_t y = 0; y < this->height; y++) {
+            for (int32_t x = 0; x < this->width; x++) {
+                image_point_list[y * this->width + x] = cv::Point2f(float(x), float(y));
+            }
+        }
+        if (is_distorted) {
+            std::vector<cv::Point2f> image_point_undistort;
+            cv::undistortPoints(image_point_list, image_point_undistort, this->K, this->dist_coeff, this->K);    /* don't use K_new */
+            image_point_list.swap(image_point_undistort);
+        }
 
-            float u = x - this->cx();
-            float v = y - this->cy();
-            float Xc = Zc * u / this->fx();
-            float Yc = Zc * v / this->fy();
-            object_point.x = Xc;
-            object_point.y = Yc;
-            object_point.z = Zc;
+        const float fx = this->fx();
+        const float cx = this->cx();
+        const float fy = this->fy();
+        const float cy = this->cy();
+        this->ray_table_.ray.resize(static_cast<size_t>(num) * 2);
+        for (int32_t i = 0; i < num; i++) {
+            this->ray_table_.ray[i * 2 + 0] = (image_point_list[i].x - cx) / fx;
+            this->ray_table_.ray[i * 2 + 1] = (image_point_list[i].y - cy) / fy;
         }
+        this->ray_table_.is_valid = true;
     }
 
     void ConvertImage2World(std::vector<cv::Point2f>& image_point_list, const std::vector<float>& z_list, std::vector<cv::Point3f>& object_point_list)
     {
         /*** Image -> Mw ***/
-        std::vector<cv::Point3f> object_point_in_camera_list;
-        ConvertImage2Camera(image_point_list, z_list, object_point_in_camera_list);
-        ConvertCamera2World(object_point_in_camera_list, object_point_list);
+        /* Mc -> Mw is done in place on the output buffer, so that no temporary list is allocated */
+        ConvertImage2Camera(image_point_list, z_list, object_point_list);
+        if (object_point_list.empty()) return;
+        ConvertCamera2World(&object_point_list[0].x, static_cast<int32_t>(object_point_list.size()), &object_point_list[0].x);
     }
 
 
@@ -555,6 +671,35 @@ public:
             object_point.z += z;
         }
     }
+
+private:
+    struct ProjectionCache {
+        /* Parameters the cache was built from */
+        std::array<float, 3> rvec;
+        std::array<float, 3> tvec;
+        std::array<float, 9> K;
+        /* float, row major */
+        std::array<float, 9> R;
+        std::array<float, 9> R_inv;
+        std::array<float, 12> Rt;       /* [R t] */
+        std::array<float, 3> R_inv_t;   /* R^1 * t */
+        std::array<float, 9> R_inv_K_inv;   /* R^1 * K^1 */
+        int32_t vanishment_y;
+        bool is_valid;
+        ProjectionCache() : is_valid(false) {}
+    } cache_;
+
+    struct RayTable {
+        /* Parameters the table was built from */
+        int32_t width;
+        int32_t height;
+        std::array<float, 9> K;
+        std::array<float, 5> dist;  /* all zero when no distortion */
+        /* float, [x0, y0, x1, y1, ...] for each pixel (row major) */
+        std::vector<float> ray;
+        bool is_valid;
+        RayTable() : width(0), height(0), is_valid(false) {}
+    } ray_table_;
 };
 
 #endif
@@ -21,6 +21,7 @@ limitations under the License.
 #include <array>
 #include <algorithm>
 #include <chrono>
+#include <fstream>
 
 #include "common_helper.h"
 
@@ -72,4 +73,43 @@ float CommonHelper::SoftMaxFast(const float* src, float* dst, int32_t length)
     return 0;
 }
 
+std::vector<int32_t> CommonHelper::CalculateTilePosition(int32_t image_size, int32_t tile_size, int32_t overlap)
+{
+    std::vector<int32_t> pos_list;
+    if (image_size <= tile_size) {
+        pos_list.push_back(0);
+        return pos_list;
+    }
+    const int32_t stride = (std::max)(1, tile_size - overlap);
+    const int32_t num = (image_size - tile_size + stride - 1) / stride + 1;
+    for (int32_t i = 0; i < num; i++) {
+        pos_list.push_back(static_cast<int32_t>(std::round(static_cast<double>(image_size - tile_size) * i / (num - 1))));
+    }
+    return pos_list;
+}
+
+static std::string Trim(const std::string& str)
+{
+    const size_t pos_start = str.find_first_not_of(" \t\r");
+    if (pos_start == std::string::npos) return "";
+    const size_t pos_end = str.find_last_not_of(" \t\r");
+    return str.substr(pos_start, pos_end - pos_start + 1);
+}
+
+bool CommonHelper::ReadKeyValueFile(const std::string& filename, std::map<std::string, std::string>& key_value_map)
+{
+    std::ifstream ifs(filename);
+    if (ifs.fail()) return false;
+    key_value_map.clear();
+    std::string str;
+    while (getline(ifs, str)) {
+        str = Trim(str);
+        if (str.empty() || str[0] == '#') continue;
+        const size_t pos = str.find('=');
+        if (pos == std::string::npos) return false;
+        key_value_map[Trim(str.substr(0, pos))] = Trim(str.substr(pos + 1));
+    }
+    return true;
+}
+
 
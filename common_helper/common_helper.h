@@ -21,6 +21,7 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <map>
 
 
 #if defined(ANDROID) || defined(__ANDROID__)
@@ -48,6 +49,10 @@ namespace CommonHelper
 float Sigmoid(float x);
 float Logit(float x);
 float SoftMaxFast(const float* src, float* dst, int32_t length);
+/* Tile positions covering [0, image_size). Tiles are evenly distributed, so the actual overlap is equal to or larger than the requested one */
+std::vector<int32_t> CalculateTilePosition(int32_t image_size, int32_t tile_size, int32_t overlap);
+/* Read "key=value" lines (e.g. config file). Empty lines and lines starting with '#' are ignored. Spaces around key and value are trimmed */
+bool ReadKeyValueFile(const std::string& filename, std::map<std::string, std::string>& key_value_map);
 
 }
 
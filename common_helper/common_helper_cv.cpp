@@ -24,6 +24,10 @@ limitations under the License.
 #include <algorithm>
 #include <chrono>
 #include <numeric>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -121,10 +125,19 @@ std::string CommonHelper::CreateGStreamerPipeline(int capture_width, int capture
         std::to_string(display_height) + ", format=(string)BGRx ! videoconvert ! video/x-raw, format=(string)BGR ! appsink max-buffers=1 drop=True";
 }
 
-bool CommonHelper::FindSourceImage(const std::string& input_name, cv::VideoCapture& cap, int32_t width, int32_t height)
+bool CommonHelper::FindSourceImage(const std::string& input_name, cv::VideoCapture& cap, int32_t width, int32_t height, int32_t decode_thread_num)
 {
     if (input_name.find(".mp4") != std::string::npos || input_name.find(".avi") != std::string::npos || input_name.find(".webm") != std::string::npos) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+        if (decode_thread_num > 0) {
+            cap = cv::VideoCapture(input_name, cv::CAP_ANY, { cv::CAP_PROP_N_THREADS, decode_thread_num });
+        } else {
+            cap = cv::VideoCapture(input_name);
+        }
+#else
+        (void)decode_thread_num;
         cap = cv::VideoCapture(input_name);
+#endif
         if (!cap.isOpened()) {
             printf("Invalid input source: %s\n", input_name.c_str());
             return false;
@@ -156,7 +169,25 @@ bool CommonHelper::FindSourceImage(const std::string& input_name, cv::VideoCaptu
     return true;
 }
 
-bool CommonHelper::InputKeyCommand(cv::VideoCapture& cap)
+bool CommonHelper::RunWarmup(int32_t width, int32_t height, int32_t iterations, const std::function<bool(const cv::Mat&)>& process)
+{
+    const cv::Mat mat(height, width, CV_8UC3, cv::Scalar(128, 128, 128));
+    for (int32_t i = 0; i < iterations; i++) {
+        if (!process(mat)) return false;
+    }
+    return true;
+}
+
+double CommonHelper::GetFrameTimestamp(cv::VideoCapture& cap)
+{
+    if (cap.get(cv::CAP_PROP_FRAME_COUNT) > 0) {
+        return cap.get(cv::CAP_PROP_POS_MSEC) / 1000.0;
+    }
+    return static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* get_position, set_position and release are for the capture */
+static bool InputKeyCommandImpl(const std::function<int32_t(void)>& get_position, const std::function<void(int32_t)>& set_position, const std::function<void(void)>& release)
 {
     bool ret_to_quit = false;
     static bool is_pause = false;
@@ -165,7 +196,7 @@ bool CommonHelper::InputKeyCommand(cv::VideoCapture& cap)
         int32_t key = cv::waitKey(1) & 0xff;
         switch (key) {
         case 'q':
-            cap.release();
+            release();
             ret_to_quit = true;
             break;
         case 'p':
@@ -175,17 +206,16 @@ bool CommonHelper::InputKeyCommand(cv::VideoCapture& cap)
             if (is_pause) {
                 is_process_one_frame = true;
             } else {
-                int32_t current_frame = static_cast<int32_t>(cap.get(cv::CAP_PROP_POS_FRAMES));
-                cap.set(cv::CAP_PROP_POS_FRAMES, current_frame + 100);
+                set_position(get_position() + 100);
             }
             break;
         case '<':
-            int32_t current_frame = static_cast<int32_t>(cap.get(cv::CAP_PROP_POS_FRAMES));
+            int32_t current_frame = get_position();
             if (is_pause) {
                 is_process_one_frame = true;
-                cap.set(cv::CAP_PROP_POS_FRAMES, current_frame - 2);
+                set_position(current_frame - 2);
             } else {
-                cap.set(cv::CAP_PROP_POS_FRAMES, current_frame - 100);
+                set_position(current_frame - 100);
             }
             break;
         }
@@ -194,6 +224,22 @@ bool CommonHelper::InputKeyCommand(cv::VideoCapture& cap)
     return ret_to_quit;
 }
 
+bool CommonHelper::InputKeyCommand(cv::VideoCapture& cap)
+{
+    return InputKeyCommandImpl(
+        [&cap]() { return static_cast<int32_t>(cap.get(cv::CAP_PROP_POS_FRAMES)); },
+        [&cap](int32_t position) { cap.set(cv::CAP_PROP_POS_FRAMES, position); },
+        [&cap]() { cap.release(); });
+}
+
+bool CommonHelper::InputKeyCommand(VideoCaptureAsync& cap)
+{
+    return InputKeyCommandImpl(
+        [&cap]() { return cap.GetPosition(); },
+        [&cap](int32_t position) { cap.Seek(position); },
+        [&cap]() { cap.Close(); });
+}
+
 CommonHelper::NiceColorGenerator::NiceColorGenerator(int32_t num)
 {
     num_ = num;
@@ -220,6 +266,125 @@ cv::Scalar CommonHelper::NiceColorGenerator::Get(int32_t id)
 }
 
 
+/* Hershey fonts have the printable ASCII characters only. Others are drawn as '?' (the same as cv::putText) */
+static constexpr int32_t kTextCharFirst = ' ';
+static constexpr int32_t kTextCharLast = '~';
+static constexpr int32_t kTextCharFallback = '?';
+static constexpr size_t kTextMaxLabelNum = 512;     /* the cache is cleared when the number of texts exceeds this */
+static constexpr int32_t kTextFontFace = cv::FONT_HERSHEY_SIMPLEX;
+
+CommonHelper::TextRenderer::TextRenderer(double font_scale, int32_t thickness)
+    : font_scale_(font_scale), thickness_(thickness), text_height_(0), baseline_(0), pad_(0), cell_width_(0), cell_height_(0)
+{
+    /* Atlas is created at the first Draw */
+}
+
+void CommonHelper::TextRenderer::CreateAtlas(void)
+{
+    /* Text height and baseline don't depend on the text */
+    int32_t baseline = 0;
+    text_height_ = cv::getTextSize("A", kTextFontFace, font_scale_, thickness_, &baseline).height;
+    baseline_ = baseline + thickness_;
+
+    /* Advance of each character. Measure a long run of the character to get the sub-pixel value */
+    static constexpr int32_t kMeasureNum = 100;
+    const int32_t char_num = kTextCharLast - kTextCharFirst + 1;
+    advance_list_.resize(char_num);
+    double advance_max = 0;
+    for (int32_t i = 0; i < char_num; i++) {
+        const std::string text(kMeasureNum, static_cast<char>(kTextCharFirst + i));
+        const int32_t width = cv::getTextSize(text, kTextFontFace, font_scale_, thickness_, &baseline).width;
+        advance_list_[i] = static_cast<double>(width - thickness_) / kMeasureNum;
+        advance_max = (std::max)(advance_max, advance_list_[i]);
+    }
+
+    /* Rasterize each glyph into a cell. The origin (bottom-left of the text) of the cell is (pad, pad + text_height) */
+    pad_ = thickness_ * 3 / 2 + 2;
+    cell_width_ = static_cast<int32_t>(std::ceil(advance_max)) + pad_ * 2;
+    cell_height_ = pad_ + text_height_ + baseline_ + pad_;
+    atlas_front_ = cv::Mat::zeros(cell_height_, cell_width_ * char_num, CV_8UC1);
+    atlas_back_ = cv::Mat::zeros(cell_height_, cell_width_ * char_num, CV_8UC1);
+    for (int32_t i = 0; i < char_num; i++) {
+        const std::string text(1, static_cast<char>(kTextCharFirst + i));
+        const cv::Rect rect_cell(cell_width_ * i, 0, cell_width_, cell_height_);
+        cv::Mat mat_cell_front = atlas_front_(rect_cell);
+        cv::Mat mat_cell_back = atlas_back_(rect_cell);
+        cv::putText(mat_cell_front, text, cv::Point(pad_, pad_ + text_height_), kTextFontFace, font_scale_, cv::Scalar(255), thickness_);
+        cv::putText(mat_cell_back, text, cv::Point(pad_, pad_ + text_height_), kTextFontFace, font_scale_, cv::Scalar(255), thickness_ * 3);
+    }
+}
+
+void CommonHelper::TextRenderer::ComposeLabel(const std::string& text, Label& label) const
+{
+    /* Compose the text from the glyphs in the atlas */
+    double view_x = 0;
+    for (const char c : text) {
+        int32_t code = static_cast<uint8_t>(c);
+        if (code < kTextCharFirst || code > kTextCharLast) code = kTextCharFallback;
+        view_x += advance_list_[code - kTextCharFirst];
+    }
+    label.width = static_cast<int32_t>(std::round(view_x + thickness_));
+    label.mask_front = cv::Mat::zeros(cell_height_, static_cast<int32_t>(std::ceil(view_x)) + cell_width_, CV_8UC1);
+    label.mask_back = cv::Mat::zeros(label.mask_front.size(), CV_8UC1);
+    view_x = 0;
+    for (const char c : text) {
+        int32_t code = static_cast<uint8_t>(c);
+        if (code < kTextCharFirst || code > kTextCharLast) code = kTextCharFallback;
+        const int32_t index = code - kTextCharFirst;
+        const cv::Rect rect_cell(cell_width_ * index, 0, cell_width_, cell_height_);
+        const cv::Rect rect_dst(static_cast<int32_t>(std::round(view_x)), 0, cell_width_, cell_height_);
+        cv::Mat mat_dst_front = label.mask_front(rect_dst);
+        cv::Mat mat_dst_back = label.mask_back(rect_dst);
+        cv::max(mat_dst_front, atlas_front_(rect_cell), mat_dst_front);
+        cv::max(mat_dst_back, atlas_back_(rect_cell), mat_dst_back);
+        view_x += advance_list_[index];
+    }
+}
+
+const CommonHelper::TextRenderer::Label& CommonHelper::TextRenderer::GetLabel(const std::string& text)
+{
+    auto it = label_map_.find(text);
+    if (it != label_map_.end()) {
+        return it->second;
+    }
+    if (label_map_.size() >= kTextMaxLabelNum) {
+        label_map_.clear();
+    }
+    Label& label = label_map_[text];
+    ComposeLabel(text, label);
+    return label;
+}
+
+void CommonHelper::TextRenderer::Draw(cv::Mat& mat, const std::string& text, cv::Point pos, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect, bool is_cached)
+{
+    if (atlas_front_.empty()) {
+        CreateAtlas();
+    }
+    Label label_temporary;
+    if (!is_cached) {
+        ComposeLabel(text, label_temporary);
+    }
+    const Label& label = is_cached ? GetLabel(text) : label_temporary;
+
+    /* The same layout as DrawText */
+    pos.y += text_height_;
+    if (is_text_on_rect) {
+        cv::rectangle(mat, pos + cv::Point(0, baseline_), pos + cv::Point(label.width, -text_height_), color_back, -1);
+    }
+
+    /* Blit the cached bitmap (clipped by the image) */
+    const cv::Rect rect_label(pos.x - pad_, pos.y - text_height_ - pad_, label.mask_front.cols, label.mask_front.rows);
+    const cv::Rect rect = rect_label & cv::Rect(0, 0, mat.cols, mat.rows);
+    if (rect.width <= 0 || rect.height <= 0) return;
+    const cv::Rect rect_mask(rect.x - rect_label.x, rect.y - rect_label.y, rect.width, rect.height);
+    cv::Mat mat_roi = mat(rect);
+    if (!is_text_on_rect) {
+        mat_roi.setTo(color_back, label.mask_back(rect_mask));
+    }
+    mat_roi.setTo(color_front, label.mask_front(rect_mask));
+}
+
+
 cv::Mat CommonHelper::CombineMat1to3(const cv::Mat& mat0, const cv::Mat& mat1, const cv::Mat& mat2)
 {
     std::vector<cv::Mat> mat_vec = { mat0, mat1, mat2 };
@@ -236,4 +401,142 @@ cv::Mat CommonHelper::CombineMat1to3(int32_t rows, int32_t cols, float* data0, f
     const cv::Mat mat2 = cv::Mat(rows, cols, CV_32FC1, data2);
     return CombineMat1to3(mat0, mat1, mat2);
 
-}
\ No newline at end of file
+}
+
+bool CommonHelper::VideoCaptureAsync::Open(cv::VideoCapture& cap, int32_t policy, int32_t buffer_num)
+{
+    Close();
+    if (!cap.isOpened() || buffer_num <= 0) {
+        printf("[VideoCaptureAsync] Invalid parameter\n");
+        return false;
+    }
+    cap_ = std::move(cap);
+    cap = cv::VideoCapture();
+    policy_ = policy;
+    frame_list_.assign(buffer_num, cv::Mat());
+    position_list_.assign(buffer_num, 0);
+    timestamp_list_.assign(buffer_num, 0.0);
+    position_ = (std::max)(0, static_cast<int32_t>(cap_.get(cv::CAP_PROP_POS_FRAMES)));
+    dropped_num_ = 0;
+    StartThread();
+    return true;
+}
+
+void CommonHelper::VideoCaptureAsync::Close(void)
+{
+    StopThread();
+    if (cap_.isOpened()) {
+        cap_.release();
+    }
+    frame_list_.clear();
+    position_list_.clear();
+    timestamp_list_.clear();
+}
+
+bool CommonHelper::VideoCaptureAsync::Read(cv::Mat& mat)
+{
+    double timestamp;
+    return Read(mat, timestamp);
+}
+
+bool CommonHelper::VideoCaptureAsync::Read(cv::Mat& mat, double& timestamp)
+{
+    if (frame_list_.empty()) {
+        return false;   /* not opened */
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_not_empty_.wait(lock, [this] { return count_ > 0 || is_end_; });
+    if (count_ == 0) {
+        return false;
+    }
+
+    int32_t index = head_;
+    if (policy_ == kPolicyLatest) {
+        /* Take the newest frame and drop the older ones */
+        index = (head_ + count_ - 1) % static_cast<int32_t>(frame_list_.size());
+        dropped_num_ += count_ - 1;
+        count_ = 1;
+    }
+    /* Swap instead of copy. The buffer of mat is reused for the following decode */
+    std::swap(mat, frame_list_[index]);
+    position_ = position_list_[index] + 1;
+    timestamp = timestamp_list_[index];
+    head_ = (index + 1) % static_cast<int32_t>(frame_list_.size());
+    count_--;
+    lock.unlock();
+    cond_not_full_.notify_one();
+    return true;
+}
+
+void CommonHelper::VideoCaptureAsync::Seek(int32_t position)
+{
+    if (!cap_.isOpened()) return;
+    StopThread();
+    cap_.set(cv::CAP_PROP_POS_FRAMES, (std::max)(0, position));
+    position_ = (std::max)(0, static_cast<int32_t>(cap_.get(cv::CAP_PROP_POS_FRAMES)));
+    StartThread();
+}
+
+void CommonHelper::VideoCaptureAsync::StartThread(void)
+{
+    head_ = 0;
+    count_ = 0;
+    is_end_ = false;
+    is_stop_ = false;
+    thread_ = std::thread(&VideoCaptureAsync::ThreadFunc, this);
+}
+
+void CommonHelper::VideoCaptureAsync::StopThread(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stop_ = true;
+    }
+    cond_not_full_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void CommonHelper::VideoCaptureAsync::ThreadFunc(void)
+{
+    int32_t position = position_;
+    cv::Mat mat_decode;     /* buffer is swapped with a slot of the ring, so that no frame is allocated in steady state */
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (is_stop_) break;
+        }
+
+        /* Decode without lock */
+        if (!cap_.read(mat_decode) || mat_decode.empty()) {
+            break;
+        }
+        const double timestamp = GetFrameTimestamp(cap_);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        const int32_t buffer_num = static_cast<int32_t>(frame_list_.size());
+        if (policy_ == kPolicyEveryFrame) {
+            cond_not_full_.wait(lock, [this, buffer_num] { return count_ < buffer_num || is_stop_; });
+        } else if (count_ == buffer_num) {
+            /* Drop the oldest frame */
+            head_ = (head_ + 1) % buffer_num;
+            count_--;
+            dropped_num_++;
+        }
+        if (is_stop_) {
+            break;
+        }
+        const int32_t index = (head_ + count_) % buffer_num;
+        std::swap(mat_decode, frame_list_[index]);
+        position_list_[index] = position++;
+        timestamp_list_[index] = timestamp;
+        count_++;
+        lock.unlock();
+        cond_not_empty_.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_end_ = true;
+    cond_not_empty_.notify_all();
+}
@@ -20,6 +20,12 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -38,8 +44,15 @@ cv::Scalar CreateCvColor(int32_t b, int32_t g, int32_t r);
 void DrawText(cv::Mat& mat, const std::string& text, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true);
 void CropResizeCvt(const cv::Mat& org, cv::Mat& dst, int32_t& crop_x, int32_t& crop_y, int32_t& crop_w, int32_t& crop_h, bool is_rgb = true, int32_t crop_type = kCropTypeStretch, bool resize_by_linear = true);
 std::string CreateGStreamerPipeline(int capture_width, int capture_height, int display_width, int display_height, int framerate, int flip_method);
-bool FindSourceImage(const std::string& input_name, cv::VideoCapture& cap, int32_t width = 640, int32_t height = 480);
+/* decode_thread_num: number of threads to decode video file (FFmpeg backend of OpenCV 4.6 or later only). 0 = backend default */
+bool FindSourceImage(const std::string& input_name, cv::VideoCapture& cap, int32_t width = 640, int32_t height = 480, int32_t decode_thread_num = 0);
 bool InputKeyCommand(cv::VideoCapture& cap);
+/* Run process with a gray image of width x height for the given iterations. process returns false on error */
+/* Lazy allocation and tuning in the inference engine and allocation of the buffers for pre/post process are done in the first runs, */
+/* so call it after initialization so that the first real frame runs at steady-state latency */
+bool RunWarmup(int32_t width, int32_t height, int32_t iterations, const std::function<bool(const cv::Mat&)>& process);
+/* Timestamp [sec] of the frame just read from cap. Position in the stream for video file, and capture time (steady clock) for live camera */
+double GetFrameTimestamp(cv::VideoCapture& cap);
 cv::Mat CombineMat1to3(const cv::Mat& mat0, const cv::Mat& mat1, const cv::Mat& mat2);
 cv::Mat CombineMat1to3(int32_t rows, int32_t cols, float* data0, float* data1, float* data2);
 
@@ -58,6 +71,97 @@ private:
 };
 
 
+/* Text drawing for the text drawn repeatedly in every frame (e.g. labels of tracked objects) */
+/* Glyphs are rasterized once into an atlas, and the bitmap of each text is composed once and cached */
+/* The result is the same as DrawText except for sub-pixel positions of characters. Not thread safe */
+class TextRenderer
+{
+public:
+    TextRenderer(double font_scale = 0.5, int32_t thickness = 1);
+    /* is_cached = false for the text which changes every frame (e.g. FPS), so that it doesn't fill the cache */
+    void Draw(cv::Mat& mat, const std::string& text, cv::Point pos, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true, bool is_cached = true);
+
+private:
+    typedef struct Label_ {
+        cv::Mat mask_front;     /* CV_8UC1, text with thickness */
+        cv::Mat mask_back;      /* CV_8UC1, text with thickness * 3 (outline) */
+        int32_t width;          /* the same as cv::getTextSize().width */
+    } Label;
+
+private:
+    void CreateAtlas(void);
+    void ComposeLabel(const std::string& text, Label& label) const;
+    const Label& GetLabel(const std::string& text);
+
+private:
+    double font_scale_;
+    int32_t thickness_;
+    int32_t text_height_;
+    int32_t baseline_;
+    int32_t pad_;           /* margin around the text for the strokes */
+    int32_t cell_width_;
+    int32_t cell_height_;
+    cv::Mat atlas_front_;   /* glyph of each character in a row of cells */
+    cv::Mat atlas_back_;
+    std::vector<double> advance_list_;
+    std::unordered_map<std::string, Label> label_map_;
+};
+
+
+/* Capture which decodes frames on its own thread into a bounded ring of reusable frames */
+/*   kPolicyLatest: the oldest frame is dropped when the ring is full, and Read returns the newest frame (for live camera) */
+/*   kPolicyEveryFrame: decoding waits when the ring is full, and Read returns every frame in order (for video file) */
+class VideoCaptureAsync
+{
+public:
+    enum {
+        kPolicyLatest = 0,
+        kPolicyEveryFrame,
+    };
+
+public:
+    VideoCaptureAsync() : policy_(kPolicyEveryFrame), head_(0), count_(0), position_(0), dropped_num_(0), is_end_(false), is_stop_(false) {}
+    ~VideoCaptureAsync() { Close(); }
+    /* cap must be opened (e.g. by FindSourceImage). It's moved into this object */
+    bool Open(cv::VideoCapture& cap, int32_t policy, int32_t buffer_num = 4);
+    void Close(void);
+    bool IsOpened(void) const { return cap_.isOpened(); }
+    /* Wait for the next frame. The buffer of mat is given back to the ring, so pass the same mat every time to avoid reallocation */
+    /* Return false at the end of the stream */
+    bool Read(cv::Mat& mat);
+    /* timestamp [sec]: timestamp of the frame (GetFrameTimestamp at decode) */
+    bool Read(cv::Mat& mat, double& timestamp);
+    /* Position (frame index) of the next frame of Read */
+    int32_t GetPosition(void) const { return position_; }
+    void Seek(int32_t position);
+    int32_t GetDroppedNum(void) const { return dropped_num_; }
+
+private:
+    void StartThread(void);
+    void StopThread(void);
+    void ThreadFunc(void);
+
+private:
+    cv::VideoCapture cap_;
+    int32_t policy_;
+    std::vector<cv::Mat> frame_list_;       /* ring buffer */
+    std::vector<int32_t> position_list_;    /* position of each frame in the ring */
+    std::vector<double> timestamp_list_;    /* timestamp of each frame in the ring */
+    int32_t head_;
+    int32_t count_;
+    std::atomic<int32_t> position_;     /* atomic because the getters are called without the lock */
+    std::atomic<int32_t> dropped_num_;
+    bool is_end_;
+    bool is_stop_;
+    std::mutex mutex_;
+    std::condition_variable cond_not_empty_;
+    std::condition_variable cond_not_full_;
+    std::thread thread_;
+};
+
+bool InputKeyCommand(VideoCaptureAsync& cap);
+
+
 }
 
 #endif
@@ -54,6 +54,13 @@ public:
         P = F * P * F.Transpose() + Q;
     }
 
+    /* Predict with F and Q for this step only (e.g. scaled by the elapsed time) */
+    void Predict(const SimpleMatrix& _F, const SimpleMatrix& _Q)
+    {
+        X = _F * X;
+        P = _F * P * _F.Transpose() + _Q;
+    }
+
     void Update(const SimpleMatrix& Z)
     {
         SimpleMatrix S = (H * P) * H.Transpose() + R;
@@ -20,6 +20,7 @@ limitations under the License.
 #include <deque>
 #include <list>
 #include <array>
+#include <algorithm>
 #include <memory>
 
 /* for My modules */
@@ -29,6 +30,16 @@ limitations under the License.
 #include "hungarian_algorithm.h"
 
 
+/* F of uniform linear motion designed for dt = 1 frame, scaled to the elapsed time: x(t) = x(t - dt) + v * dt */
+static SimpleMatrix ScaleTransitionMatrix(const SimpleMatrix& F, double dt)
+{
+    SimpleMatrix F_dt = F;
+    F_dt(0, 4) = dt;    /* cx += vx * dt */
+    F_dt(1, 5) = dt;    /* cy += vy * dt */
+    F_dt(2, 6) = dt;    /* area += vz * dt */
+    return F_dt;
+}
+
 Track::Track(const int32_t id, const BoundingBox& bbox_det)
 {
     Data data;
@@ -47,9 +58,10 @@ Track::~Track()
 {
 }
 
-BoundingBox Track::Predict()
+BoundingBox Track::Predict(double dt)
 {
-    kf_.Predict();
+    /* Noise is accumulated in proportion to the elapsed time */
+    kf_.Predict(ScaleTransitionMatrix(kf_.F, dt), kf_.Q * dt);
 
     BoundingBox bbox = GetLatestBoundingBox();
     BoundingBox bbox_pred = KalmanStatus2Bbox(kf_.X);   // w, y, w, h only
@@ -70,6 +82,18 @@ BoundingBox Track::Predict()
     return bbox;
 }
 
+BoundingBox Track::GetPredictedBoundingBox(double dt) const
+{
+    BoundingBox bbox = GetLatestBoundingBox();
+    BoundingBox bbox_pred = KalmanStatus2Bbox(ScaleTransitionMatrix(kf_.F, dt) * kf_.X);   // w, y, w, h only
+    bbox.w = bbox_pred.w;
+    bbox.h = bbox_pred.h;
+    bbox.x = bbox_pred.x;
+    bbox.y = bbox_pred.y;
+    bbox.score = 0.0F;
+    return bbox;
+}
+
 void Track::Update(const BoundingBox& bbox_det)
 {
     kf_.Update(Bbox2KalmanObserved(bbox_det));
@@ -217,7 +241,7 @@ SimpleMatrix Track::Bbox2KalmanObserved(const BoundingBox& bbox)
     return Z;
 }
 
-BoundingBox Track::KalmanStatus2Bbox(const SimpleMatrix& X)
+BoundingBox Track::KalmanStatus2Bbox(const SimpleMatrix& X) const
 {
     BoundingBox bbox;
     bbox.w = static_cast<int32_t>(std::sqrt(X(2, 0) * X(3, 0)));
@@ -230,11 +254,14 @@ BoundingBox Track::KalmanStatus2Bbox(const SimpleMatrix& X)
 
 
 constexpr float Tracker::kCostMax;  // for link error in Android Studio (clang)
+constexpr double Tracker::kMaxElapsedFrame;
 Tracker::Tracker()
 {
     track_sequence_num_ = 0;
     threshold_frame_to_delete_ = 2;
     threshold_iou_to_track_ = 0.3F;
+    frame_interval_ = 1.0 / 30;
+    timestamp_previous_ = -1.0;
 }
 
 Tracker::~Tracker()
@@ -245,6 +272,7 @@ void Tracker::Reset()
 {
     track_list_.clear();
     track_sequence_num_ = 0;
+    timestamp_previous_ = -1.0;
 }
 
 
@@ -253,7 +281,7 @@ std::vector<Track>& Tracker::GetTrackList()
     return track_list_;
 }
 
-float Tracker::CalculateSimilarity(const BoundingBox& bbox0, const BoundingBox& bbox1)
+float Tracker::CalculateSimilarity(const BoundingBox& bbox0, const BoundingBox& bbox1) const
 {
     float iou = BoundingBoxUtils::CalculateIoU(bbox0, bbox1);
     if (iou > 0.9) {
@@ -273,12 +301,43 @@ float Tracker::CalculateSimilarity(const BoundingBox& bbox0, const BoundingBox&
     return kCostMax - iou;
 }
 
-void Tracker::Update(const std::vector<BoundingBox>& det_list)
+double Tracker::GetElapsedFrame(double timestamp) const
+{
+    /* Elapsed time in the unit of the nominal frame interval */
+    double dt = 1.0;
+    if (timestamp >= 0 && timestamp_previous_ >= 0) {
+        dt = (timestamp - timestamp_previous_) / frame_interval_;
+        dt = (std::min)((std::max)(dt, 0.0), kMaxElapsedFrame);
+    }
+    return dt;
+}
+
+double Tracker::CalculateElapsedFrame(double timestamp)
+{
+    const double dt = GetElapsedFrame(timestamp);
+    if (timestamp >= 0) {
+        timestamp_previous_ = timestamp;
+    }
+    return dt;
+}
+
+void Tracker::Predict(double timestamp)
+{
+    /* Just predict the position. Undetected count is not increased because detection is not executed */
+    /* The predicted bbox has score = 0 */
+    const double dt = CalculateElapsedFrame(timestamp);
+    for (auto& track : track_list_) {
+        track.Predict(dt);
+    }
+}
+
+void Tracker::Update(const std::vector<BoundingBox>& det_list, double timestamp)
 {
     /*** Predict the position at the current frame using the previous status for all tracked bbox ***/
+    const double dt = CalculateElapsedFrame(timestamp);
     std::vector<BoundingBox> bbox_pred_list;
     for (auto& track : track_list_) {
-        BoundingBox bbox_prd = track.Predict();
+        BoundingBox bbox_prd = track.Predict(dt);
         bbox_pred_list.push_back(bbox_prd);
     }
 
@@ -348,3 +407,70 @@ void Tracker::Update(const std::vector<BoundingBox>& det_list)
     }
 }
 
+
+FrameSkipController::FrameSkipController(int32_t max_interval, float max_motion_per_interval, double time_budget)
+{
+    max_interval_ = max_interval;
+    max_motion_per_interval_ = max_motion_per_interval;
+    time_budget_ = time_budget;
+    is_enabled_ = false;
+    frame_cnt_since_detection_ = 0;
+    detection_interval_ = 1;
+}
+
+void FrameSkipController::SetEnabled(bool is_enabled)
+{
+    is_enabled_ = is_enabled;
+    frame_cnt_since_detection_ = 0;
+    detection_interval_ = 1;
+}
+
+bool FrameSkipController::IsDetectionFrame()
+{
+    if (!is_enabled_) return true;
+    if (++frame_cnt_since_detection_ < detection_interval_) return false;
+    frame_cnt_since_detection_ = 0;
+    return true;
+}
+
+void FrameSkipController::UpdateTracker(Tracker& tracker, bool is_detection_frame, const std::vector<BoundingBox>& det_list, double time_detection, double timestamp)
+{
+    if (is_detection_frame) {
+        tracker.Update(det_list, timestamp);
+        if (is_enabled_) {
+            detection_interval_ = CalculateDetectionInterval(tracker, time_detection);
+        }
+    } else {
+        tracker.Predict(timestamp);
+    }
+}
+
+int32_t FrameSkipController::CalculateDetectionInterval(Tracker& tracker, double time_detection) const
+{
+    /* The largest motion per frame relative to the object size */
+    int32_t num_track = 0;
+    float motion_max = 0.0f;
+    for (auto& track : tracker.GetTrackList()) {
+        const auto& track_history = track.GetDataHistory();
+        if (track_history.size() < 2) continue;
+        const auto& bbox0 = track_history[track_history.size() - 2].bbox;
+        const auto& bbox1 = track_history[track_history.size() - 1].bbox;
+        const float dx = (bbox1.x + bbox1.w / 2.0f) - (bbox0.x + bbox0.w / 2.0f);
+        const float dy = (bbox1.y + bbox1.h / 2.0f) - (bbox0.y + bbox0.h / 2.0f);
+        const float size = static_cast<float>((std::max)(1, (std::max)(bbox1.w, bbox1.h)));
+        motion_max = (std::max)(motion_max, std::sqrt(dx * dx + dy * dy) / size);
+        num_track++;
+    }
+
+    /* No track to be predicted -> detect every frame as long as the time budget allows */
+    int32_t interval_motion = 1;
+    if (num_track > 0) {
+        interval_motion = (motion_max > 0) ? static_cast<int32_t>(max_motion_per_interval_ / motion_max) : max_interval_;
+    }
+    /* Interval needed to keep the time budget on average (prediction time is negligible) */
+    const int32_t interval_budget = static_cast<int32_t>(std::ceil(time_detection / time_budget_));
+
+    const int32_t interval = (std::max)((std::min)(interval_motion, max_interval_), (std::min)(interval_budget, max_interval_));
+    return (std::max)(1, interval);
+}
+
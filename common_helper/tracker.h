@@ -44,7 +44,8 @@ public:
     Track(const int32_t id, const BoundingBox& bbox_det);
     ~Track();
 
-    BoundingBox Predict();
+    BoundingBox Predict(double dt = 1.0);   /* dt: elapsed time in frames */
+    BoundingBox GetPredictedBoundingBox(double dt = 1.0) const;    /* Predict the position at the next frame without changing the status */
     void Update(const BoundingBox& bbox_det);
     void UpdateNoDetect();
 
@@ -60,7 +61,7 @@ private:
     KalmanFilter CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start);
     SimpleMatrix Bbox2KalmanObserved(const BoundingBox& bbox);
     SimpleMatrix Bbox2KalmanStatus(const BoundingBox& bbox);
-    BoundingBox KalmanStatus2Bbox(const SimpleMatrix& X);
+    BoundingBox KalmanStatus2Bbox(const SimpleMatrix& X) const;
 
 private:
     std::deque<Data> data_history_;
@@ -72,20 +73,30 @@ private:
 
 
 class Tracker {
-private:
+public:
     static constexpr float kCostMax = 1.0F;
+private:
+    static constexpr double kMaxElapsedFrame = 30.0;    /* to avoid divergence after a long pause */
 
 public:
     Tracker();
     ~Tracker();
     void Reset();
 
-    void Update(const std::vector<BoundingBox>& det_list);
+    /* timestamp [sec]: F and Q of Kalman Filter are scaled by the elapsed time. Use 1 frame interval if timestamp is not given (< 0) */
+    void Update(const std::vector<BoundingBox>& det_list, double timestamp = -1.0);
+    void Predict(double timestamp = -1.0);     /* for the frame where detection is not executed */
+    void SetFrameInterval(double frame_interval) { frame_interval_ = frame_interval; }
+    /* Elapsed time [frame] from the last Update/Predict to timestamp, without changing the status. 1 if timestamp is not given (< 0) */
+    double GetElapsedFrame(double timestamp) const;
 
     std::vector<Track>& GetTrackList();
 
+    /* Cost of association (kCostMax - IoU). kCostMax means they cannot be the same object */
+    float CalculateSimilarity(const BoundingBox& bbox0, const BoundingBox& bbox1) const;
+
 private:
-    float CalculateSimilarity(const BoundingBox& bbox0, const BoundingBox& bbox1);
+    double CalculateElapsedFrame(double timestamp);
 
 private:
     std::vector<Track> track_list_;
@@ -93,6 +104,36 @@ private:
 
     int32_t threshold_frame_to_delete_;
     float threshold_iou_to_track_;
+
+    double frame_interval_;         /* [sec] nominal frame interval, which corresponds to dt = 1 */
+    double timestamp_previous_;     /* [sec] */
+};
+
+
+/* Adaptive frame skip: detection runs every "interval" frames, and the tracker predicts the positions in-between frames */
+/* The interval is chosen from the motion of tracks and the time budget per frame */
+class FrameSkipController {
+public:
+    FrameSkipController(int32_t max_interval = 4, float max_motion_per_interval = 0.3f, double time_budget = 1000.0 / 60);
+    ~FrameSkipController() {}
+    void SetEnabled(bool is_enabled);
+    bool IsEnabled() const { return is_enabled_; }
+    /* Call once per frame. Always true when disabled */
+    bool IsDetectionFrame();
+    /* Update the tracker with det_list in the detection frame, or just predict in the other frames */
+    /* time_detection [msec]: time taken for the detection, to keep the time budget */
+    void UpdateTracker(Tracker& tracker, bool is_detection_frame, const std::vector<BoundingBox>& det_list, double time_detection, double timestamp = -1.0);
+
+private:
+    int32_t CalculateDetectionInterval(Tracker& tracker, double time_detection) const;
+
+private:
+    int32_t max_interval_;              /* detector runs at least once in this number of frames */
+    float max_motion_per_interval_;     /* allowed motion b/w detections (ratio to object size) */
+    double time_budget_;                /* [msec] per frame */
+    bool is_enabled_;
+    int32_t frame_cnt_since_detection_;
+    int32_t detection_interval_;
 };
 
 #endif
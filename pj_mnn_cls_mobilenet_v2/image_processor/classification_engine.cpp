@@ -94,6 +94,25 @@ int32_t ClassificationEngine::Finalize()
 }
 
 
+int32_t ClassificationEngine::Warmup(int32_t iterations)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    /* Results of warmup are not printed */
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    const int32_t verbose = verbose_;
+    verbose_ = kVerboseNone;
+    const bool is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), iterations, [this](const cv::Mat& mat) {
+        Result result;
+        return Process(mat, result) == kRetOk;
+    });
+    verbose_ = verbose;
+    return is_ok ? kRetOk : kRetErr;
+}
+
+
 int32_t ClassificationEngine::Process(const cv::Mat& original_mat, Result& result)
 {
     if (!inference_helper_) {
@@ -109,7 +128,9 @@ int32_t ClassificationEngine::Process(const cv::Mat& original_mat, Result& resul
     int32_t crop_y = 0;
     int32_t crop_w = original_mat.cols;
     int32_t crop_h = original_mat.rows;
-    cv::Mat img_src = cv::Mat::zeros(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
+    img_src_.create(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
+    img_src_.setTo(0);
+    cv::Mat& img_src = img_src_;
     //CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
     //CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeCut);
     CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeExpand);
@@ -140,18 +161,15 @@ int32_t ClassificationEngine::Process(const cv::Mat& original_mat, Result& resul
 
     /*** PostProcess ***/
     const auto& t_post_process0 = std::chrono::steady_clock::now();
-    /* Retrieve the result */
-    std::vector<float> output_score_list;
-    output_score_list.resize(output_tensor_info_list_[0].GetElementNum());
+    /* Retrieve the result directly from the output tensor */
     const float* val_float = output_tensor_info_list_[0].GetDataAsFloat();
-    for (int32_t i = 0; i < (int32_t)output_score_list.size(); i++) {
-        output_score_list[i] = val_float[i];
+    const int32_t num_score = (std::min)(static_cast<int32_t>(output_tensor_info_list_[0].GetElementNum()), static_cast<int32_t>(label_list_.size()));
+    SelectTopK(val_float, num_score, result.top_k_list);
+    const int32_t max_index = result.top_k_list[0].class_id;
+    const float max_score = result.top_k_list[0].score;
+    if (verbose_ >= kVerboseResult) {
+        PRINT("Result = %s (%d) (%.3f)\n", label_list_[max_index].c_str(), max_index, max_score);
     }
-
-    /* Find the max score */
-    int32_t max_index = (int32_t)(std::max_element(output_score_list.begin(), output_score_list.end()) - output_score_list.begin());
-    auto max_score = *std::max_element(output_score_list.begin(), output_score_list.end());
-    PRINT("Result = %s (%d) (%.3f)\n", label_list_[max_index].c_str(), max_index, max_score);
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
     /* Return the results */
@@ -165,6 +183,44 @@ int32_t ClassificationEngine::Process(const cv::Mat& original_mat, Result& resul
     return kRetOk;
 }
 
+int32_t ClassificationEngine::Process(const std::vector<cv::Mat>& original_mat_list, std::vector<Result>& result_list)
+{
+    /* The model takes batch = 1, so crops are processed sequentially with the same work buffers */
+    result_list.resize(original_mat_list.size());
+    for (size_t i = 0; i < original_mat_list.size(); i++) {
+        if (Process(original_mat_list[i], result_list[i]) != kRetOk) {
+            return kRetErr;
+        }
+    }
+    return kRetOk;
+}
+
+
+void ClassificationEngine::SelectTopK(const float* score_list, int32_t num_score, std::vector<Candidate>& top_k_list)
+{
+    const int32_t top_k = (std::max)(1, (std::min)(top_k_, num_score));
+
+    /* Partial selection over indices, so that the scores are not copied */
+    score_index_list_.resize(num_score);
+    for (int32_t i = 0; i < num_score; i++) score_index_list_[i] = i;
+    const auto compare = [score_list](int32_t a, int32_t b) { return score_list[a] > score_list[b]; };
+    std::partial_sort(score_index_list_.begin(), score_index_list_.begin() + top_k, score_index_list_.end(), compare);
+
+    top_k_score_list_.resize(top_k);
+    for (int32_t i = 0; i < top_k; i++) {
+        top_k_score_list_[i] = score_list[score_index_list_[i]];
+    }
+    if (is_softmax_top_k_) {
+        CommonHelper::SoftMaxFast(top_k_score_list_.data(), top_k_score_list_.data(), top_k);
+    }
+
+    top_k_list.resize(top_k);
+    for (int32_t i = 0; i < top_k; i++) {
+        top_k_list[i].class_id = score_index_list_[i];
+        top_k_list[i].score = top_k_score_list_[i];
+    }
+}
+
 
 int32_t ClassificationEngine::ReadLabel(const std::string& filename, std::vector<std::string>& label_list)
 {
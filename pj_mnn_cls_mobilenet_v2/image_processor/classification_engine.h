@@ -23,10 +23,23 @@ public:
         kRetErr = -1,
     };
 
+    enum {
+        kVerboseNone = 0,
+        kVerboseResult = 1,     /* print the result every frame */
+    };
+
+    typedef struct Candidate_ {
+        int32_t     class_id;
+        float       score;
+        Candidate_() : class_id(0), score(0.0f)
+        {}
+    } Candidate;
+
     typedef struct Result_ {
         int32_t     class_id;
         std::string class_name;
         float       score;
+        std::vector<Candidate> top_k_list;      /* sorted by score (descending). top_k_list[0] is the same as class_id/score */
         double      time_pre_process;		// [msec]
         double      time_inference;			// [msec]
         double      time_post_process;		// [msec]
@@ -38,20 +51,37 @@ private:
     bool with_background = true;
 
 public:
-    ClassificationEngine() {}
+    ClassificationEngine() : top_k_(1), is_softmax_top_k_(false), verbose_(kVerboseNone) {}
     ~ClassificationEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
     int32_t Finalize(void);
+    int32_t Warmup(int32_t iterations);
     int32_t Process(const cv::Mat& original_mat, Result& result);
+    /* Process crops one by one. Buffers (including result_list) are reused among calls */
+    int32_t Process(const std::vector<cv::Mat>& original_mat_list, std::vector<Result>& result_list);
+    /* is_softmax: apply softmax to the K winners only (for models which output logits) */
+    void SetTopK(int32_t top_k, bool is_softmax = false) { top_k_ = top_k; is_softmax_top_k_ = is_softmax; }
+    void SetVerbose(int32_t verbose) { verbose_ = verbose; }
+    const std::string& GetLabel(int32_t class_id) const { return label_list_[class_id]; }
 
 private:
     int32_t ReadLabel(const std::string& filename, std::vector<std::string>& label_list);
+    void SelectTopK(const float* score_list, int32_t num_score, std::vector<Candidate>& top_k_list);
 
 private:
     std::unique_ptr<InferenceHelper> inference_helper_;
     std::vector<InputTensorInfo> input_tensor_info_list_;
     std::vector<OutputTensorInfo> output_tensor_info_list_;
     std::vector<std::string> label_list_;
+
+    int32_t top_k_;
+    bool is_softmax_top_k_;
+    int32_t verbose_;
+
+    /* Work buffers reused every frame */
+    cv::Mat img_src_;
+    std::vector<int32_t> score_index_list_;
+    std::vector<float> top_k_score_list_;
 };
 
 #endif
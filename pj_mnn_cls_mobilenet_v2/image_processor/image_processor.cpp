@@ -55,6 +55,19 @@ int32_t ImageProcessor::Initialize(const InputParam& input_param)
     return 0;
 }
 
+int32_t ImageProcessor::Warmup(int32_t iterations)
+{
+    if (!s_classification_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+
+    if (s_classification_engine->Warmup(iterations) != ClassificationEngine::kRetOk) {
+        return -1;
+    }
+    return 0;
+}
+
 int32_t ImageProcessor::Finalize(void)
 {
     if (!s_classification_engine) {
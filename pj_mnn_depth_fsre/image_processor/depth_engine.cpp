@@ -102,6 +102,21 @@ int32_t DepthEngine::Finalize()
 }
 
 
+int32_t DepthEngine::Warmup(int32_t iterations)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    const bool is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), iterations, [this](const cv::Mat& mat) {
+        Result result;
+        return Process(mat, result) == kRetOk;
+    });
+    return is_ok ? kRetOk : kRetErr;
+}
+
+
 int32_t DepthEngine::Process(const cv::Mat& original_mat, Result& result)
 {
     if (!inference_helper_) {
@@ -152,7 +167,9 @@ int32_t DepthEngine::Process(const cv::Mat& original_mat, Result& result)
     int32_t output_channel = output_tensor_info_list_[0].GetChannel();
     float* values = output_tensor_info_list_[0].GetDataAsFloat();
     //printf("%f, %f, %f\n", values[0], values[100], values[400]);
-    cv::Mat mat_out = cv::Mat(output_height, output_width, CV_32FC1, values);
+    /* View of the output tensor (no copy) */
+    cv::Mat mat_disparity = cv::Mat(output_height, output_width, CV_32FC1, values);
+    cv::Mat mat_out = mat_disparity;
 #if 0
     /* (255 * (prediction - depth_min) / (depth_max - depth_min)) */
     double depth_min, depth_max;
@@ -165,6 +182,7 @@ int32_t DepthEngine::Process(const cv::Mat& original_mat, Result& result)
 
     /* Return the results */
     result.mat_out = mat_out;
+    result.mat_disparity = mat_disparity;
     result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
     result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
     result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;;
@@ -39,6 +39,7 @@ public:
 
     typedef struct Result_ {
         cv::Mat           mat_out;              // [height, width, 1]. value is 0 - 255
+        cv::Mat           mat_disparity;        // [height, width, 1]. CV_32FC1, raw output of the model (0.0 - 1.0). View of the output tensor, valid until the next Process (clone to keep it)
         double            time_pre_process;		// [msec]
         double            time_inference;		// [msec]
         double            time_post_process;	// [msec]
@@ -51,6 +52,7 @@ public:
     ~DepthEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
     int32_t Finalize(void);
+    int32_t Warmup(int32_t iterations);
     int32_t Process(const cv::Mat& original_mat, Result& result);
 
 
@@ -33,6 +33,7 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "depth_engine.h"
+#include "point_cloud.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -40,8 +41,22 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/* Point cloud. Default values when InputParam doesn't give them */
+#define POINT_CLOUD_FOV         80.0f   /* Horizontal FoV of the input image [deg] */
+#define POINT_CLOUD_DECIMATION  2
+#define POINT_CLOUD_FILENAME    "point_cloud"
+
 /*** Global variable ***/
 std::unique_ptr<DepthEngine> s_engine;
+static std::string s_work_dir;
+static bool s_is_point_cloud_enabled = false;
+static bool s_is_point_cloud_ply_requested = false;
+static float s_point_cloud_fov = POINT_CLOUD_FOV;
+static int32_t s_point_cloud_decimation = POINT_CLOUD_DECIMATION;
+static std::string s_point_cloud_path;     /* binary file to record */
+static PointCloudGenerator s_point_cloud_generator;
+static PointCloudWriter s_point_cloud_writer;
+static std::vector<cv::Point3f> s_point_list;   /* reused across frames */
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -55,6 +70,39 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
     CommonHelper::DrawText(mat, text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 }
 
+static int32_t ProcessPointCloud(const cv::Mat& mat_disparity, const cv::Size& image_size)
+{
+    static cv::Size s_image_size;
+    if (s_image_size != image_size) {
+        /* (Re)initialize only when the image size is changed */
+        if (s_point_cloud_generator.Initialize(mat_disparity.cols, mat_disparity.rows, image_size.width, image_size.height, s_point_cloud_fov, s_point_cloud_decimation) != PointCloudGenerator::kRetOk) {
+            return -1;
+        }
+        s_image_size = image_size;
+    }
+
+    if (s_point_cloud_generator.Process(mat_disparity, s_point_list) != PointCloudGenerator::kRetOk) {
+        return -1;
+    }
+
+    if (s_point_cloud_writer.IsOpen()) {
+        if (s_point_cloud_writer.Write(s_point_list) != PointCloudWriter::kRetOk) {
+            s_point_cloud_writer.Close();
+            return -1;
+        }
+    }
+    if (s_is_point_cloud_ply_requested) {
+        s_is_point_cloud_ply_requested = false;
+        PointCloudWriter writer;
+        if (writer.Open(s_work_dir + "/" + POINT_CLOUD_FILENAME, PointCloudWriter::kFormatPly) != PointCloudWriter::kRetOk
+            || writer.Write(s_point_list) != PointCloudWriter::kRetOk) {
+            return -1;
+        }
+        PRINT("Point cloud (%d points) is saved\n", static_cast<int32_t>(s_point_list.size()));
+    }
+    return 0;
+}
+
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
     if (s_engine) {
@@ -68,6 +116,35 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         s_engine.reset();
         return -1;
     }
+    s_work_dir = input_param.work_dir;
+
+    s_point_cloud_fov = input_param.point_cloud_fov > 0 ? input_param.point_cloud_fov : POINT_CLOUD_FOV;
+    s_point_cloud_decimation = input_param.point_cloud_decimation > 0 ? input_param.point_cloud_decimation : POINT_CLOUD_DECIMATION;
+    s_is_point_cloud_enabled = input_param.is_point_cloud_enabled;
+    if (input_param.point_cloud_path[0] != '\0') {
+        s_point_cloud_path = input_param.point_cloud_path;
+        if (s_point_cloud_writer.Open(s_point_cloud_path, PointCloudWriter::kFormatBinary) != PointCloudWriter::kRetOk) {
+            s_engine->Finalize();
+            s_engine.reset();
+            return -1;
+        }
+        s_is_point_cloud_enabled = true;
+    } else {
+        s_point_cloud_path = s_work_dir + "/" + POINT_CLOUD_FILENAME + ".bin";
+    }
+    return 0;
+}
+
+int32_t ImageProcessor::Warmup(int32_t iterations)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+
+    if (s_engine->Warmup(iterations) != DepthEngine::kRetOk) {
+        return -1;
+    }
     return 0;
 }
 
@@ -78,6 +155,7 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
+    s_point_cloud_writer.Close();
     if (s_engine->Finalize() != DepthEngine::kRetOk) {
         return -1;
     }
@@ -95,6 +173,29 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
     switch (cmd) {
     case 0:
+        /* Point cloud generation on/off */
+        s_is_point_cloud_enabled = !s_is_point_cloud_enabled;
+        if (!s_is_point_cloud_enabled) s_point_cloud_writer.Close();
+        PRINT("Point cloud: %s\n", s_is_point_cloud_enabled ? "on" : "off");
+        return 0;
+    case 1:
+        /* Recording point cloud of all frames into one binary file on/off */
+        if (s_point_cloud_writer.IsOpen()) {
+            s_point_cloud_writer.Close();
+            PRINT("Point cloud recording: off\n");
+            return 0;
+        }
+        if (s_point_cloud_writer.Open(s_point_cloud_path, PointCloudWriter::kFormatBinary) != PointCloudWriter::kRetOk) {
+            return -1;
+        }
+        s_is_point_cloud_enabled = true;
+        PRINT("Point cloud recording: on\n");
+        return 0;
+    case 2:
+        /* Save point cloud of the next frame as PLY */
+        s_is_point_cloud_enabled = true;
+        s_is_point_cloud_ply_requested = true;
+        return 0;
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
         return -1;
@@ -114,6 +215,16 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    /* Convert to point cloud (before the input image is modified for the result image) */
+    if (s_is_point_cloud_enabled) {
+        const auto& t_point_cloud0 = std::chrono::steady_clock::now();
+        if (ProcessPointCloud(ss_result.mat_disparity, mat.size()) != 0) {
+            return -1;
+        }
+        const auto& t_point_cloud1 = std::chrono::steady_clock::now();
+        ss_result.time_post_process += static_cast<std::chrono::duration<double>>(t_point_cloud1 - t_point_cloud0).count() * 1000.0;
+    }
+
     /* Convert to colored depth map */
     cv::Mat mat_depth;
     cv::applyColorMap(ss_result.mat_out, mat_depth, cv::COLORMAP_MAGMA);
@@ -29,9 +29,14 @@ namespace cv {
 namespace ImageProcessor
 {
 
+/* Parameters for point cloud are optional. 0 (zero-initialized) = default */
 typedef struct {
     char     work_dir[256];
     int32_t  num_threads;
+    bool     is_point_cloud_enabled;    // Point cloud generation from the first frame. It can be turned on/off by Command(0) as well
+    int32_t  point_cloud_decimation;    // Use every n-th pixel of the disparity map. 0 = default (2)
+    float    point_cloud_fov;           // Horizontal FoV of the input image [deg]. 0 = default (80)
+    char     point_cloud_path[256];     // Record the point cloud of all frames into this binary file from the first frame. Empty = recording is off (Command(1))
 } InputParam;
 
 typedef struct {
@@ -44,6 +49,8 @@ int32_t Initialize(const InputParam& input_param);
 int32_t Process(cv::Mat& mat, Result& result);
 int32_t Finalize(void);
 int32_t Command(int32_t cmd);
+/* Run the engines with synthetic images (CommonHelper::RunWarmup). Call after Initialize */
+int32_t Warmup(int32_t iterations = 2);
 
 }
 
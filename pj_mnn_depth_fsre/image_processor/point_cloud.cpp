@@ -0,0 +1,193 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "camera_model.h"
+#include "point_cloud.h"
+
+/*** Macro ***/
+#define TAG "PointCloud"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+int32_t PointCloudGenerator::Initialize(int32_t depth_width, int32_t depth_height, int32_t image_width, int32_t image_height, float fov_deg, int32_t decimation)
+{
+    if (depth_width <= 0 || depth_height <= 0 || image_width <= 0 || image_height <= 0 || decimation <= 0) {
+        PRINT_E("Invalid parameter\n");
+        return kRetErr;
+    }
+    depth_width_ = depth_width;
+    depth_height_ = depth_height;
+    decimation_ = decimation;
+
+    /* The original image is stretched to the model input, so fx and fy are scaled differently */
+    const float focal_length = FocalLength(image_width, fov_deg);
+    const float fx = focal_length * depth_width / image_width;
+    const float fy = focal_length * depth_height / image_height;
+
+    /* Intrinsic parameters of the decimated grid. The pixel (x, y) on the grid is the pixel (x * decimation, y * decimation) on the disparity map */
+    const int32_t grid_width = (depth_width + decimation - 1) / decimation;
+    const int32_t grid_height = (depth_height + decimation - 1) / decimation;
+    camera_.SetIntrinsic(grid_width, grid_height, fx / decimation);
+    camera_.fy() = fy / decimation;
+    camera_.cx() = (depth_width / 2.f) / decimation;
+    camera_.cy() = (depth_height / 2.f) / decimation;
+    camera_.UpdateNewCameraMatrix();
+
+    z_list_.resize(static_cast<size_t>(grid_width) * grid_height);
+    return kRetOk;
+}
+
+
+int32_t PointCloudGenerator::Process(const cv::Mat& mat_disparity, std::vector<cv::Point3f>& point_list)
+{
+    const size_t num = static_cast<size_t>(GetPointNum());
+    if (point_list.size() != num) {
+        point_list.resize(num);
+    }
+    return Process(mat_disparity, &point_list[0].x);
+}
+
+
+int32_t PointCloudGenerator::Process(const cv::Mat& mat_disparity, float* point_buffer)
+{
+    if (depth_width_ <= 0) {
+        PRINT_E("Not initialized\n");
+        return kRetErr;
+    }
+    if (mat_disparity.cols != depth_width_ || mat_disparity.rows != depth_height_ || mat_disparity.type() != CV_32FC1) {
+        PRINT_E("Invalid disparity map\n");
+        return kRetErr;
+    }
+
+    /*** Disparity -> Depth on the decimated grid ***/
+    const float min_disp = 1.0f / depth_param_.max_depth;
+    const float max_disp = 1.0f / depth_param_.min_depth;
+    const float scale = depth_param_.scale;
+    const int32_t grid_width = GetGridWidth();
+    const int32_t grid_height = GetGridHeight();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int32_t y = 0; y < grid_height; y++) {
+        const float* src = mat_disparity.ptr<float>(y * decimation_);
+        float* dst = &z_list_[y * grid_width];
+        for (int32_t x = 0; x < grid_width; x++) {
+            const float disparity = (std::max)(0.0f, (std::min)(1.0f, src[x * decimation_]));
+            dst[x] = scale / (min_disp + (max_disp - min_disp) * disparity);
+        }
+    }
+
+    /*** Depth -> Mc -> Mw ***/
+    /* Mc -> Mw is done in place, so that no intermediate buffer is needed */
+    camera_.ConvertImage2Camera(z_list_.data(), point_buffer);
+    camera_.ConvertCamera2World(point_buffer, GetPointNum(), point_buffer);
+
+    return kRetOk;
+}
+
+
+int32_t PointCloudWriter::Open(const std::string& path, int32_t format)
+{
+    Close();
+    if (format == kFormatBinary) {
+        ofs_.open(path, std::ios::out | std::ios::binary);
+        if (!ofs_) {
+            PRINT_E("Failed to open %s\n", path.c_str());
+            return kRetErr;
+        }
+    } else if (format != kFormatPly) {
+        PRINT_E("Invalid format (%d)\n", format);
+        return kRetErr;
+    }
+    path_ = path;
+    format_ = format;
+    frame_index_ = 0;
+    return kRetOk;
+}
+
+
+void PointCloudWriter::Close(void)
+{
+    if (ofs_.is_open()) {
+        ofs_.close();
+    }
+    path_.clear();
+}
+
+
+int32_t PointCloudWriter::Write(const std::vector<cv::Point3f>& point_list)
+{
+    return Write(point_list.empty() ? nullptr : &point_list[0].x, static_cast<int32_t>(point_list.size()));
+}
+
+
+int32_t PointCloudWriter::Write(const float* point_buffer, int32_t num)
+{
+    if (!IsOpen()) {
+        PRINT_E("Not opened\n");
+        return kRetErr;
+    }
+
+    /* The buffer is written as it is (no conversion). Both formats are little endian */
+    const std::streamsize data_size = static_cast<std::streamsize>(num) * 3 * sizeof(float);
+    if (format_ == kFormatBinary) {
+        ofs_.write(reinterpret_cast<const char*>(&frame_index_), sizeof(frame_index_));
+        ofs_.write(reinterpret_cast<const char*>(&num), sizeof(num));
+        if (num > 0) ofs_.write(reinterpret_cast<const char*>(point_buffer), data_size);
+        ofs_.flush();
+        if (!ofs_) {
+            PRINT_E("Failed to write %s\n", path_.c_str());
+            return kRetErr;
+        }
+    } else {
+        char filename[512];
+        snprintf(filename, sizeof(filename), "%s_%05d.ply", path_.c_str(), frame_index_);
+        std::ofstream ofs(filename, std::ios::out | std::ios::binary);
+        if (!ofs) {
+            PRINT_E("Failed to open %s\n", filename);
+            return kRetErr;
+        }
+        ofs << "ply\n"
+            << "format binary_little_endian 1.0\n"
+            << "element vertex " << num << "\n"
+            << "property float x\n"
+            << "property float y\n"
+            << "property float z\n"
+            << "end_header\n";
+        if (num > 0) ofs.write(reinterpret_cast<const char*>(point_buffer), data_size);
+        if (!ofs) {
+            PRINT_E("Failed to write %s\n", filename);
+            return kRetErr;
+        }
+    }
+    frame_index_++;
+    return kRetOk;
+}
@@ -0,0 +1,109 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef POINT_CLOUD_
+#define POINT_CLOUD_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "camera_model.h"
+
+
+/* Convert disparity map (output of DepthEngine) into 3D point cloud in world coordinate */
+class PointCloudGenerator {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    /* depth = scale / (min_disp + (max_disp - min_disp) * disparity), min_disp = 1 / max_depth, max_disp = 1 / min_depth */
+    /* The model is trained with monocular video, so the depth is relative. scale is the stereo scale factor used for KITTI */
+    typedef struct DepthParam_ {
+        float min_depth;
+        float max_depth;
+        float scale;
+        DepthParam_() : min_depth(0.1f), max_depth(100.0f), scale(5.4f)
+        {}
+    } DepthParam;
+
+public:
+    PointCloudGenerator() : depth_width_(0), depth_height_(0), decimation_(1) {}
+    ~PointCloudGenerator() {}
+    /* depth_width/height: size of the disparity map. image_width/height: size of the original image the disparity map is estimated from */
+    /* fov_deg: horizontal FoV of the original image. decimation: use every n-th pixel of the disparity map in x and y */
+    int32_t Initialize(int32_t depth_width, int32_t depth_height, int32_t image_width, int32_t image_height, float fov_deg, int32_t decimation = 1);
+    /* point_list is resized only when the number of points is changed, so pass the same buffer every frame */
+    /* point_list[y * GetGridWidth() + x] is the point of the pixel (x * decimation, y * decimation) on the disparity map */
+    int32_t Process(const cv::Mat& mat_disparity, std::vector<cv::Point3f>& point_list);
+    /* point_buffer must be preallocated with GetPointNum() * 3 floats ([x, y, z] * num) */
+    int32_t Process(const cv::Mat& mat_disparity, float* point_buffer);
+
+    void SetDepthParam(const DepthParam& depth_param) { depth_param_ = depth_param; }
+    CameraModel& GetCamera() { return camera_; }    /* to set extrinsic parameters */
+    int32_t GetGridWidth() const { return camera_.width; }
+    int32_t GetGridHeight() const { return camera_.height; }
+    int32_t GetPointNum() const { return camera_.width * camera_.height; }
+
+private:
+    CameraModel camera_;    /* intrinsic parameters are for the decimated grid */
+    DepthParam depth_param_;
+    int32_t depth_width_;
+    int32_t depth_height_;
+    int32_t decimation_;
+    std::vector<float> z_list_;
+};
+
+
+/* Write point cloud to file frame by frame */
+/*   kFormatBinary: all frames in one file. [int32 frame_index, int32 num, float [x, y, z] * num] for each frame */
+/*   kFormatPly: one binary PLY file for each frame. filename = path_prefix + "_%05d.ply" */
+class PointCloudWriter {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    enum {
+        kFormatBinary = 0,
+        kFormatPly,
+    };
+
+public:
+    PointCloudWriter() : format_(kFormatBinary), frame_index_(0) {}
+    ~PointCloudWriter() { Close(); }
+    int32_t Open(const std::string& path, int32_t format);
+    void Close(void);
+    bool IsOpen(void) const { return !path_.empty(); }
+    int32_t Write(const std::vector<cv::Point3f>& point_list);
+    int32_t Write(const float* point_buffer, int32_t num);
+
+private:
+    std::string path_;
+    int32_t format_;
+    int32_t frame_index_;
+    std::ofstream ofs_;
+};
+
+#endif
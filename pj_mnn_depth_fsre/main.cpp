@@ -16,6 +16,7 @@ limitations under the License.
 /* for general */
 #include <cstdint>
 #include <cstdlib>
+#include <cstdio>
 #include <string>
 #include <algorithm>
 #include <chrono>
@@ -45,8 +46,29 @@ int32_t main(int argc, char* argv[])
     double total_time_inference = 0;
     double total_time_post_process = 0;
 
+    /* Parse arguments */
+    /*   --point-cloud: generate point cloud from the disparity map */
+    /*   --point-cloud-decimation=n: use every n-th pixel of the disparity map (default: 2) */
+    /*   --point-cloud-fov=deg: horizontal FoV of the input image (default: 80) */
+    /*   --point-cloud-output=path: record the point cloud of all frames into a binary file (implies --point-cloud) */
+    std::string input_name = DEFAULT_INPUT_IMAGE;
+    ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
+    for (int32_t i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--point-cloud") {
+            input_param.is_point_cloud_enabled = true;
+        } else if (arg.find("--point-cloud-decimation=") == 0) {
+            input_param.point_cloud_decimation = (std::max)(1, std::atoi(arg.substr(25).c_str()));
+        } else if (arg.find("--point-cloud-fov=") == 0) {
+            input_param.point_cloud_fov = static_cast<float>(std::atof(arg.substr(18).c_str()));
+        } else if (arg.find("--point-cloud-output=") == 0) {
+            snprintf(input_param.point_cloud_path, sizeof(input_param.point_cloud_path), "%s", arg.substr(21).c_str());
+        } else {
+            input_name = arg;
+        }
+    }
+
     /* Find source image */
-    std::string input_name = (argc > 1) ? argv[1] : DEFAULT_INPUT_IMAGE;
     cv::VideoCapture cap;   /* if cap is not opened, src is still image */
     if (!CommonHelper::FindSourceImage(input_name, cap)) {
         return -1;
@@ -56,12 +78,13 @@ int32_t main(int argc, char* argv[])
     cv::VideoWriter writer;
 
     /* Initialize image processor library */
-    ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
     if (ImageProcessor::Initialize(input_param) != 0) {
         printf("Initialization Error\n");
         return -1;
     }
 
+    ImageProcessor::Warmup();
+
     /*** Process for each frame ***/
     int32_t frame_cnt = 0;
     for (frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
@@ -24,6 +24,11 @@ limitations under the License.
 #include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <sstream>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -40,13 +45,19 @@ limitations under the License.
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
 /* Model parameters */
-#if 1
-#define MODEL_NAME  "yolov7-tiny_384x640.mnn"
-#define INPUT_DIMS  { 1, 3, 384, 640 }
-#else
-#define MODEL_NAME  "yolov7_736x1280.onnx"
-#define INPUT_DIMS  { 1, 3, 736, 1280 }
-#endif
+/* Default model config. Another config can be given at Initialize and Reload */
+/* Models for each resolution level (from low to high). Models which don't exist are skipped */
+static const struct {
+    const char* name;
+    int32_t     height;
+    int32_t     width;
+} kModelList[] = {
+    { "yolov7-tiny_256x320.mnn",  256,  320 },
+    { "yolov7-tiny_384x640.mnn",  384,  640 },
+    { "yolov7-tiny_736x1280.mnn", 736, 1280 },
+    //{ "yolov7_736x1280.mnn",      736, 1280 },
+};
+static constexpr int32_t kDefaultModelIndex = 1;    /* used when the latency controller is disabled */
 #define TENSORTYPE  TensorInfo::kTensorTypeFp32
 #define INPUT_NAME  "images"
 #define IS_NCHW     true
@@ -60,17 +71,299 @@ static constexpr int32_t kElementNumOfAnchor = kNumberOfClass + 5;    // x, y, w
 
 
 /*** Function ***/
-int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
+constexpr int32_t DetectionEngine::kTileBatchSize;  // for link error in Android Studio (clang)
+
+/* Box touching the tile border which is not the image border shows only a part of the object */
+static bool IsCutAtTileBorder(const BoundingBox& bbox, const cv::Rect& tile, const cv::Size& image_size, int32_t margin)
+{
+    if (tile.x > 0 && bbox.x <= tile.x + margin) return true;
+    if (tile.y > 0 && bbox.y <= tile.y + margin) return true;
+    if (tile.x + tile.width < image_size.width && bbox.x + bbox.w >= tile.x + tile.width - margin) return true;
+    if (tile.y + tile.height < image_size.height && bbox.y + bbox.h >= tile.y + tile.height - margin) return true;
+    return false;
+}
+
+static float CalculateOverlapOfSmaller(const BoundingBox& obj0, const BoundingBox& obj1)
+{
+    int32_t interx0 = (std::max)(obj0.x, obj1.x);
+    int32_t intery0 = (std::max)(obj0.y, obj1.y);
+    int32_t interx1 = (std::min)(obj0.x + obj0.w, obj1.x + obj1.w);
+    int32_t intery1 = (std::min)(obj0.y + obj0.h, obj1.y + obj1.h);
+    if (interx1 < interx0 || intery1 < intery0) return 0;
+
+    int32_t area_min = (std::max)(1, (std::min)(obj0.w * obj0.h, obj1.w * obj1.h));
+    int32_t area_inter = (interx1 - interx0) * (intery1 - intery0);
+    return static_cast<float>(area_inter) / area_min;
+}
+
+DetectionEngine::ModelConfig DetectionEngine::CreateDefaultModelConfig(void)
+{
+    ModelConfig model_config;
+    for (const auto& model : kModelList) {
+        ModelConfig::Model m;
+        m.name = model.name;
+        m.height = model.height;
+        m.width = model.width;
+        model_config.model_list.push_back(m);
+    }
+    model_config.default_model_index = kDefaultModelIndex;
+    model_config.input_name = INPUT_NAME;
+    model_config.output_name = OUTPUT_NAME;
+    model_config.label_name = LABEL_NAME;
+    return model_config;
+}
+
+int32_t DetectionEngine::ReadModelConfig(const std::string& filename, ModelConfig& model_config)
+{
+    std::map<std::string, std::string> key_value_map;
+    if (!CommonHelper::ReadKeyValueFile(filename, key_value_map)) {
+        PRINT_E("Failed to read %s\n", filename.c_str());
+        return kRetErr;
+    }
+
+    /* model_list is replaced as a whole if any model is given */
+    std::vector<ModelConfig::Model> model_list;
+    for (int32_t i = 0; key_value_map.count("model" + std::to_string(i)) > 0; i++) {
+        const std::string& value = key_value_map["model" + std::to_string(i)];
+        std::istringstream iss(value);
+        ModelConfig::Model model;
+        if (!(iss >> model.name >> model.height >> model.width) || model.height <= 0 || model.width <= 0) {
+            PRINT_E("Invalid model%d: %s\n", i, value.c_str());
+            return kRetErr;
+        }
+        model_list.push_back(model);
+    }
+    if (!model_list.empty()) model_config.model_list = model_list;
+
+    for (const auto& key_value : key_value_map) {
+        const std::string& key = key_value.first;
+        const std::string& value = key_value.second;
+        if (key == "default_model_index") {
+            model_config.default_model_index = std::atoi(value.c_str());
+        } else if (key == "input_name") {
+            model_config.input_name = value;
+        } else if (key == "output_name") {
+            model_config.output_name = value;
+        } else if (key == "label_name") {
+            model_config.label_name = value;
+        } else if (key.find("model") != 0) {
+            PRINT("Unknown key in %s: %s. Ignored\n", filename.c_str(), key.c_str());
+        }
+    }
+
+    if (model_config.default_model_index < 0 || model_config.default_model_index >= static_cast<int32_t>(model_config.model_list.size())) {
+        PRINT_E("Invalid default_model_index: %d\n", model_config.default_model_index);
+        return kRetErr;
+    }
+    return kRetOk;
+}
+
+DetectionEngine::SessionSet_::~SessionSet_()
+{
+    for (auto& session : session_list) {
+        if (session.inference_helper) session.inference_helper->Finalize();
+    }
+    if (tile_session.inference_helper) tile_session.inference_helper->Finalize();
+}
+
+int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t num_threads, const ModelConfig& model_config)
+{
+    work_dir_ = work_dir;
+    num_threads_ = num_threads;
+
+    std::shared_ptr<SessionSet> session_set;
+    if (CreateSessionSet(model_config, session_set) != kRetOk) {
+        return kRetErr;
+    }
+    session_set_ = session_set;
+    session_index_ = session_set_->default_session_index;
+    latency_list_.assign(session_set_->session_list.size(), 0.0);
+
+    return kRetOk;
+}
+
+int32_t DetectionEngine::Finalize()
+{
+    if (reload_thread_.joinable()) reload_thread_.join();
+    session_set_reloaded_.reset();
+    if (!session_set_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    session_set_.reset();
+    return kRetOk;
+}
+
+
+int32_t DetectionEngine::Warmup(int32_t iterations)
+{
+    if (!session_set_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    /* All the resolutions are warmed up because the latency controller may switch to any of them */
+    for (int32_t index = 0; index < static_cast<int32_t>(session_set_->session_list.size()); index++) {
+        const InputTensorInfo& input_tensor_info = session_set_->session_list[index].input_tensor_info_list[0];
+        const bool is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), iterations, [this, index](const cv::Mat& mat) {
+            Result result;
+            return ProcessRoi(*session_set_, index, mat, cv::Rect(0, 0, mat.cols, mat.rows), result) == kRetOk;
+        });
+        if (!is_ok) return kRetErr;
+    }
+    return kRetOk;
+}
+
+
+int32_t DetectionEngine::WarmupSliced(int32_t iterations)
+{
+    if (!IsSlicedInferenceAvailable()) {
+        PRINT_E("Session for tiles is not created\n");
+        return kRetErr;
+    }
+    /* Tiles are not skipped, so that the batch actually runs */
+    const InputTensorInfo& tile_input_tensor_info = session_set_->tile_session.input_tensor_info_list[0];
+    const bool is_skip_empty_tile = is_skip_empty_tile_;
+    is_skip_empty_tile_ = false;
+    const bool is_ok = CommonHelper::RunWarmup(tile_input_tensor_info.GetWidth(), tile_input_tensor_info.GetHeight(), iterations, [this](const cv::Mat& mat) {
+        Result result;
+        return ProcessSliced(mat, result) == kRetOk;
+    });
+    is_skip_empty_tile_ = is_skip_empty_tile;
+    return is_ok ? kRetOk : kRetErr;
+}
+
+
+int32_t DetectionEngine::Reload(const ModelConfig& model_config)
+{
+    if (is_reloading_) {
+        PRINT_E("Reload is in progress\n");
+        return kRetErr;
+    }
+    if (reload_thread_.joinable()) reload_thread_.join();
+
+    /* Create the new sessions on a background thread not to stop Process. They are swapped in by SwapSessionSet at the next frame */
+    is_reloading_ = true;
+    reload_thread_ = std::thread([this, model_config]() {
+        std::shared_ptr<SessionSet> session_set;
+        if (CreateSessionSet(model_config, session_set) == kRetOk) {
+            std::lock_guard<std::mutex> lock(reload_mutex_);
+            session_set_reloaded_ = session_set;
+        } else {
+            PRINT_E("Failed to reload. The current model is kept\n");
+        }
+        is_reloading_ = false;
+    });
+    return kRetOk;
+}
+
+
+void DetectionEngine::SwapSessionSet(void)
+{
+    std::shared_ptr<SessionSet> session_set_old;    /* released after unlock */
+    {
+        std::lock_guard<std::mutex> lock(reload_mutex_);
+        if (!session_set_reloaded_) return;
+        session_set_old = session_set_;
+        session_set_ = session_set_reloaded_;
+        session_set_reloaded_.reset();
+    }
+
+    reload_cnt_++;
+
+    /* The latency measured with the old models is no longer valid */
+    session_index_ = session_set_->default_session_index;
+    latency_list_.assign(session_set_->session_list.size(), 0.0);
+    latency_average_ = 0;
+    cnt_since_switch_ = 0;
+    PRINT("Model is reloaded: %s\n", session_set_->session_list[session_index_].model_name.c_str());
+}
+
+
+int32_t DetectionEngine::CreateSessionSet(const ModelConfig& model_config, std::shared_ptr<SessionSet>& session_set)
 {
-    /* Set model information */
-    std::string model_filename = work_dir + "/model/" + MODEL_NAME;
-    std::string labelFilename = work_dir + "/model/" + LABEL_NAME;
+    const auto& t_create0 = std::chrono::steady_clock::now();
+    session_set.reset(new SessionSet());
+    session_set->model_config = model_config;
+
+    /* read label in parallel with session creation */
+    int32_t ret_read_label = kRetErr;
+    double time_read_label = 0;
+    std::vector<std::string> label_list;
+    std::thread label_thread([this, &model_config, &ret_read_label, &time_read_label, &label_list]() {
+        const auto& t_read_label0 = std::chrono::steady_clock::now();
+        ret_read_label = ReadLabel(work_dir_ + "/model/" + model_config.label_name, label_list);
+        const auto& t_read_label1 = std::chrono::steady_clock::now();
+        time_read_label = static_cast<std::chrono::duration<double>>(t_read_label1 - t_read_label0).count() * 1000.0;
+    });
+
+    /* Create sessions for all the resolutions */
+    int32_t ret = kRetOk;
+    for (int32_t i = 0; i < static_cast<int32_t>(model_config.model_list.size()); i++) {
+        const ModelConfig::Model& model = model_config.model_list[i];
+        std::ifstream ifs(work_dir_ + "/model/" + model.name);
+        if (ifs.fail()) {
+            PRINT("%s is not found. Skipped\n", model.name.c_str());
+            continue;
+        }
+        const auto& t_session0 = std::chrono::steady_clock::now();
+        Session session;
+        if (CreateSession(model_config, model, 1, session) != kRetOk) {
+            ret = kRetErr;
+            break;
+        }
+        const auto& t_session1 = std::chrono::steady_clock::now();
+        PRINT("Startup: %s (model load + session create) = %.3lf [msec]\n", model.name.c_str(), static_cast<std::chrono::duration<double>>(t_session1 - t_session0).count() * 1000.0);
+        if (i == model_config.default_model_index) session_set->default_session_index = static_cast<int32_t>(session_set->session_list.size());
+        session_set->session_list.push_back(std::move(session));
+    }
+
+    /* Session for sliced inference. Same model as the default resolution, but with batch = kTileBatchSize */
+    /* Created here (not at the first sliced frame), so that turning on sliced inference doesn't stall for model load */
+    /* It's optional, so failure (e.g. model which cannot be resized to the batch) doesn't fail the whole set */
+    if (ret == kRetOk && !session_set->session_list.empty() && model_config.is_tile_session_created) {
+        const auto& t_session0 = std::chrono::steady_clock::now();
+        const Session& session_default = session_set->session_list[session_set->default_session_index];
+        ModelConfig::Model model;
+        model.name = session_default.model_name;
+        model.height = session_default.input_tensor_info_list[0].GetHeight();
+        model.width = session_default.input_tensor_info_list[0].GetWidth();
+        if (CreateSession(model_config, model, kTileBatchSize, session_set->tile_session) != kRetOk) {
+            PRINT_E("Failed to create session for tiles. Sliced inference is not available\n");
+        } else {
+            const auto& t_session1 = std::chrono::steady_clock::now();
+            PRINT("Startup: %s (batch %d for tiles) = %.3lf [msec]\n", model.name.c_str(), kTileBatchSize, static_cast<std::chrono::duration<double>>(t_session1 - t_session0).count() * 1000.0);
+        }
+    }
+
+    label_thread.join();
+    if (ret != kRetOk || ret_read_label != kRetOk) {
+        return kRetErr;
+    }
+    if (session_set->session_list.empty()) {
+        PRINT_E("No model\n");
+        return kRetErr;
+    }
+    session_set->label_list = std::move(label_list);
+
+    const auto& t_create1 = std::chrono::steady_clock::now();
+    PRINT("Startup: label read = %.3lf [msec]\n", time_read_label);
+    PRINT("Startup: total = %.3lf [msec]\n", static_cast<std::chrono::duration<double>>(t_create1 - t_create0).count() * 1000.0);
+
+    return kRetOk;
+}
+
+
+int32_t DetectionEngine::CreateSession(const ModelConfig& model_config, const ModelConfig::Model& model, int32_t batch, Session& session)
+{
+    std::string model_filename = work_dir_ + "/model/" + model.name;
+    session.model_name = model.name;
 
     /* Set input tensor info */
-    input_tensor_info_list_.clear();
-    InputTensorInfo input_tensor_info(INPUT_NAME, TENSORTYPE, IS_NCHW);
-    input_tensor_info.tensor_dims = INPUT_DIMS;
-    input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
+    /* Batched input is given as a pre-processed blob */
+    session.input_tensor_info_list.clear();
+    InputTensorInfo input_tensor_info(model_config.input_name, TENSORTYPE, IS_NCHW);
+    input_tensor_info.tensor_dims = { batch, 3, model.height, model.width };
+    input_tensor_info.data_type = (batch == 1) ? InputTensorInfo::kDataTypeImage : InputTensorInfo::kDataTypeBlobNchw;
     /* normalize to [0.0, 1.0] */
     input_tensor_info.normalize.mean[0] = 0.0f;
     input_tensor_info.normalize.mean[1] = 0.0f;
@@ -78,44 +371,71 @@ int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t n
     input_tensor_info.normalize.norm[0] = 1.0f;
     input_tensor_info.normalize.norm[1] = 1.0f;
     input_tensor_info.normalize.norm[2] = 1.0f;
-    input_tensor_info_list_.push_back(input_tensor_info);
+    session.input_tensor_info_list.push_back(input_tensor_info);
 
     /* Set output tensor info */
-    output_tensor_info_list_.clear();
-    output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME, TENSORTYPE));
+    session.output_tensor_info_list.clear();
+    session.output_tensor_info_list.push_back(OutputTensorInfo(model_config.output_name, TENSORTYPE));
 
     /* Create and Initialize Inference Helper */
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kOnnxRuntime));
-    inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kMnn));
+    //session.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kOnnxRuntime));
+    session.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kMnn));
 
-    if (!inference_helper_) {
+    if (!session.inference_helper) {
         return kRetErr;
     }
-    if (inference_helper_->SetNumThreads(num_threads) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
+    if (session.inference_helper->SetNumThreads(num_threads_) != InferenceHelper::kRetOk) {
+        session.inference_helper.reset();
         return kRetErr;
     }
-    if (inference_helper_->Initialize(model_filename, input_tensor_info_list_, output_tensor_info_list_) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
+    if (session.inference_helper->Initialize(model_filename, session.input_tensor_info_list, session.output_tensor_info_list) != InferenceHelper::kRetOk) {
+        session.inference_helper.reset();
         return kRetErr;
     }
+    return kRetOk;
+}
 
-    /* read label */
-    if (ReadLabel(labelFilename, label_list_) != kRetOk) {
-        return kRetErr;
-    }
 
-    return kRetOk;
+void DetectionEngine::SetLatencyBudget(double latency_budget)
+{
+    latency_budget_ = latency_budget;
+    latency_average_ = 0;
+    cnt_since_switch_ = 0;
+    if (latency_budget_ <= 0 && session_set_) {
+        session_index_ = session_set_->default_session_index;
+    }
 }
 
-int32_t DetectionEngine::Finalize()
+
+void DetectionEngine::UpdateResolutionLevel(const SessionSet& session_set, double latency)
 {
-    if (!inference_helper_) {
-        PRINT_E("Inference helper is not created\n");
-        return kRetErr;
+    const std::vector<Session>& session_list = session_set.session_list;
+
+    /* Moving average of the latency of the current resolution */
+    latency_average_ = (cnt_since_switch_ == 0) ? latency : latency_average_ * 0.8 + latency * 0.2;
+    latency_list_[session_index_] = latency_average_;
+    cnt_since_switch_++;
+    if (cnt_since_switch_ < kMinFrameToSwitch) return;
+
+    int32_t session_index_next = session_index_;
+    if (latency_average_ > latency_budget_ * kLatencyRatioDown) {
+        if (session_index_ > 0) session_index_next = session_index_ - 1;
+    } else if (session_index_ < static_cast<int32_t>(session_list.size()) - 1) {
+        /* Use the latency measured before if available. Otherwise, assume the latency is proportional to the number of pixels */
+        double latency_expected = latency_list_[session_index_ + 1];
+        if (latency_expected <= 0) {
+            const InputTensorInfo& input_current = session_list[session_index_].input_tensor_info_list[0];
+            const InputTensorInfo& input_next = session_list[session_index_ + 1].input_tensor_info_list[0];
+            latency_expected = latency_average_ * (input_next.GetWidth() * input_next.GetHeight()) / (input_current.GetWidth() * input_current.GetHeight());
+        }
+        if (latency_expected < latency_budget_ * kLatencyRatioUp) session_index_next = session_index_ + 1;
+    }
+
+    if (session_index_next != session_index_) {
+        session_index_ = session_index_next;
+        cnt_since_switch_ = 0;
+        PRINT("Resolution is switched to %s\n", session_list[session_index_].model_name.c_str());
     }
-    inference_helper_->Finalize();
-    return kRetOk;
 }
 
 
@@ -150,20 +470,68 @@ void DetectionEngine::GetBoundingBox(const float* data, int32_t anchor_box_num,
 }
 
 
+cv::Rect DetectionEngine::AdjustRoi(const cv::Rect& roi, const cv::Size& image_size, const cv::Size& input_size) const
+{
+    /* Expand to the aspect ratio of the model input not to distort objects by stretch. */
+    /* Also, ROI smaller than the model input doesn't add information, so expand it to the model input size at least */
+    const int32_t input_w = input_size.width;
+    const int32_t input_h = input_size.height;
+    const float aspect = static_cast<float>(input_w) / input_h;
+    float w = static_cast<float>((std::max)(roi.width, (std::min)(input_w, image_size.width)));
+    float h = static_cast<float>((std::max)(roi.height, (std::min)(input_h, image_size.height)));
+    if (w / h > aspect) {
+        h = w / aspect;
+    } else {
+        w = h * aspect;
+    }
+    cv::Rect roi_adjusted;
+    roi_adjusted.width = (std::min)(static_cast<int32_t>(w), image_size.width);
+    roi_adjusted.height = (std::min)(static_cast<int32_t>(h), image_size.height);
+    roi_adjusted.x = roi.x + roi.width / 2 - roi_adjusted.width / 2;
+    roi_adjusted.y = roi.y + roi.height / 2 - roi_adjusted.height / 2;
+    roi_adjusted.x = (std::min)((std::max)(0, roi_adjusted.x), image_size.width - roi_adjusted.width);
+    roi_adjusted.y = (std::min)((std::max)(0, roi_adjusted.y), image_size.height - roi_adjusted.height);
+    return roi_adjusted;
+}
+
+
 int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
 {
-    if (!inference_helper_) {
+    return Process(original_mat, cv::Rect(0, 0, original_mat.cols, original_mat.rows), result);
+}
+
+
+int32_t DetectionEngine::Process(const cv::Mat& original_mat, const cv::Rect& roi, Result& result)
+{
+    /* Swap in the reloaded models between frames. The frame in process keeps using the sessions it started with */
+    SwapSessionSet();
+    std::shared_ptr<SessionSet> session_set = session_set_;
+    if (!session_set) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
     }
+    if (ProcessRoi(*session_set, session_index_, original_mat, roi, result) != kRetOk) {
+        return kRetErr;
+    }
+    if (latency_budget_ > 0) {
+        UpdateResolutionLevel(*session_set, result.time_pre_process + result.time_inference + result.time_post_process);
+    }
+    return kRetOk;
+}
+
+
+int32_t DetectionEngine::ProcessRoi(SessionSet& session_set, int32_t session_index, const cv::Mat& original_mat, const cv::Rect& roi, Result& result)
+{
+    Session& session = session_set.session_list[session_index];
     /*** PreProcess ***/
     const auto& t_pre_process0 = std::chrono::steady_clock::now();
-    InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    InputTensorInfo& input_tensor_info = session.input_tensor_info_list[0];
     /* do crop, resize and color conversion here because some inference engine doesn't support these operations */
-    int32_t crop_x = 0;
-    int32_t crop_y = 0;
-    int32_t crop_w = original_mat.cols;
-    int32_t crop_h = original_mat.rows;
+    const cv::Rect roi_adjusted = AdjustRoi(roi, original_mat.size(), cv::Size(input_tensor_info.GetWidth(), input_tensor_info.GetHeight()));
+    int32_t crop_x = roi_adjusted.x;
+    int32_t crop_y = roi_adjusted.y;
+    int32_t crop_w = roi_adjusted.width;
+    int32_t crop_h = roi_adjusted.height;
     cv::Mat img_src = cv::Mat::zeros(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
     CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
     //CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeCut);
@@ -180,14 +548,14 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     input_tensor_info.image_info.crop_height = img_src.rows;
     input_tensor_info.image_info.is_bgr = false;
     input_tensor_info.image_info.swap_color = false;
-    if (inference_helper_->PreProcess(input_tensor_info_list_) != InferenceHelper::kRetOk) {
+    if (session.inference_helper->PreProcess(session.input_tensor_info_list) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
     const auto& t_pre_process1 = std::chrono::steady_clock::now();
 
     /*** Inference ***/
     const auto& t_inference0 = std::chrono::steady_clock::now();
-    if (inference_helper_->Process(output_tensor_info_list_) != InferenceHelper::kRetOk) {
+    if (session.inference_helper->Process(session.output_tensor_info_list) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
     const auto& t_inference1 = std::chrono::steady_clock::now();
@@ -196,8 +564,8 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     const auto& t_post_process0 = std::chrono::steady_clock::now();
     /* Get boundig box */
     std::vector<BoundingBox> bbox_list;
-    float* output_data = output_tensor_info_list_[0].GetDataAsFloat();
-    int32_t anchor_box_num = output_tensor_info_list_[0].tensor_dims[1];
+    float* output_data = session.output_tensor_info_list[0].GetDataAsFloat();
+    int32_t anchor_box_num = session.output_tensor_info_list[0].tensor_dims[1];
     float scale_x = static_cast<float>(crop_w) / input_tensor_info.GetWidth();      /* scale to original image */
     float scale_y = static_cast<float>(crop_h) / input_tensor_info.GetHeight();
     GetBoundingBox(output_data, anchor_box_num, scale_x, scale_y, bbox_list);
@@ -206,7 +574,7 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     for (auto& bbox : bbox_list) {
         bbox.x += crop_x;  
         bbox.y += crop_y;
-        bbox.label = label_list_[bbox.class_id];
+        bbox.label = session_set.label_list[bbox.class_id];
     }
 
     /* NMS */
@@ -229,6 +597,207 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
 }
 
 
+void DetectionEngine::MergeTileBoundingBox(std::vector<BoundingBox>& bbox_list, const std::vector<bool>& is_cut_list, std::vector<BoundingBox>& bbox_merged_list)
+{
+    std::vector<int32_t> index_list(bbox_list.size());
+    for (size_t i = 0; i < index_list.size(); i++) index_list[i] = static_cast<int32_t>(i);
+    std::sort(index_list.begin(), index_list.end(), [&bbox_list](int32_t lhs, int32_t rhs) {
+        return bbox_list[lhs].score > bbox_list[rhs].score;
+        });
+
+    /* Usual NMS by IoU. In addition, a box cut at tile border is merged into the box of the same class covering it, */
+    /* because IoU between a part and the whole object is small */
+    std::vector<bool> is_merged_cut_list;
+    for (int32_t index : index_list) {
+        const BoundingBox& bbox = bbox_list[index];
+        bool is_merged = false;
+        for (size_t i = 0; i < bbox_merged_list.size(); i++) {
+            BoundingBox& bbox_merged = bbox_merged_list[i];
+            if (BoundingBoxUtils::CalculateIoU(bbox_merged, bbox) > threshold_nms_iou_) {
+                is_merged = true;
+            } else if ((is_cut_list[index] || is_merged_cut_list[i]) && bbox_merged.class_id == bbox.class_id
+                && CalculateOverlapOfSmaller(bbox_merged, bbox) > kThresholdTileMergeOverlap) {
+                /* Union of the parts of the object. Keep the score of the higher one */
+                int32_t x0 = (std::min)(bbox_merged.x, bbox.x);
+                int32_t y0 = (std::min)(bbox_merged.y, bbox.y);
+                int32_t x1 = (std::max)(bbox_merged.x + bbox_merged.w, bbox.x + bbox.w);
+                int32_t y1 = (std::max)(bbox_merged.y + bbox_merged.h, bbox.y + bbox.h);
+                bbox_merged.x = x0;
+                bbox_merged.y = y0;
+                bbox_merged.w = x1 - x0;
+                bbox_merged.h = y1 - y0;
+                is_merged_cut_list[i] = is_merged_cut_list[i] && is_cut_list[index];
+                is_merged = true;
+            }
+            if (is_merged) break;
+        }
+        if (!is_merged) {
+            bbox_merged_list.push_back(bbox);
+            is_merged_cut_list.push_back(is_cut_list[index]);
+        }
+    }
+}
+
+
+int32_t DetectionEngine::ProcessSliced(const cv::Mat& original_mat, Result& result)
+{
+    SwapSessionSet();
+    std::shared_ptr<SessionSet> session_set = session_set_;
+    if (!session_set) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    Session& tile_session = session_set->tile_session;
+    if (!tile_session.inference_helper) {
+        return Process(original_mat, result);
+    }
+
+    /*** PreProcess ***/
+    const auto& t_pre_process0 = std::chrono::steady_clock::now();
+    const InputTensorInfo& input_tensor_info = tile_session.input_tensor_info_list[0];
+    const int32_t input_w = input_tensor_info.GetWidth();
+    const int32_t input_h = input_tensor_info.GetHeight();
+    const int32_t tile_w = (std::min)(input_w, original_mat.cols);
+    const int32_t tile_h = (std::min)(input_h, original_mat.rows);
+    std::vector<cv::Rect> tile_list;
+    for (int32_t pos_y : CommonHelper::CalculateTilePosition(original_mat.rows, tile_h, tile_overlap_)) {
+        for (int32_t pos_x : CommonHelper::CalculateTilePosition(original_mat.cols, tile_w, tile_overlap_)) {
+            tile_list.push_back(cv::Rect(pos_x, pos_y, tile_w, tile_h));
+        }
+    }
+
+    /* Low-res full-frame pass. Its result is also merged with the result of tiles (for large objects) */
+    /* Always the lowest resolution, and not fed to the latency controller which is for Process */
+    std::vector<BoundingBox> bbox_list;
+    std::vector<bool> is_cut_list;
+    if (is_skip_empty_tile_) {
+        Result full_frame_result;
+        if (ProcessRoi(*session_set, 0, original_mat, cv::Rect(0, 0, original_mat.cols, original_mat.rows), full_frame_result) != kRetOk) {
+            return kRetErr;
+        }
+        std::vector<cv::Rect> active_tile_list;
+        for (const auto& tile : tile_list) {
+            for (const auto& bbox : full_frame_result.bbox_list) {
+                if ((tile & cv::Rect(bbox.x, bbox.y, bbox.w, bbox.h)).area() > 0) {
+                    active_tile_list.push_back(tile);
+                    break;
+                }
+            }
+        }
+        tile_list = active_tile_list;
+        for (const auto& bbox : full_frame_result.bbox_list) {
+            bbox_list.push_back(bbox);
+            is_cut_list.push_back(false);
+        }
+    }
+
+    const int32_t num_tile = static_cast<int32_t>(tile_list.size());
+    const int32_t num_batch = (num_tile + kTileBatchSize - 1) / kTileBatchSize;
+    const int32_t blob_size_per_tile = 3 * input_h * input_w;
+    tile_blob_.resize(static_cast<size_t>(kTileBatchSize) * blob_size_per_tile);
+    const auto& t_pre_process1 = std::chrono::steady_clock::now();
+
+    double time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
+    double time_inference = 0;
+    double time_post_process = 0;
+    for (int32_t batch = 0; batch < num_batch; batch++) {
+        const int32_t tile_index_start = batch * kTileBatchSize;
+        const int32_t num_tile_in_batch = (std::min)(kTileBatchSize, num_tile - tile_index_start);
+
+        /*** PreProcess ***/
+        /* Crop, resize, color conversion and normalization to [0.0, 1.0] into the batched NCHW blob */
+        const auto& t_pre_process_batch0 = std::chrono::steady_clock::now();
+#pragma omp parallel for
+        for (int32_t i = 0; i < kTileBatchSize; i++) {
+            float* blob = tile_blob_.data() + static_cast<size_t>(i) * blob_size_per_tile;
+            if (i >= num_tile_in_batch) {
+                std::fill(blob, blob + blob_size_per_tile, 0.0f);
+                continue;
+            }
+            const cv::Rect& tile = tile_list[tile_index_start + i];
+            int32_t crop_x = tile.x;
+            int32_t crop_y = tile.y;
+            int32_t crop_w = tile.width;
+            int32_t crop_h = tile.height;
+            cv::Mat img_src(input_h, input_w, CV_8UC3);
+            CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
+            for (int32_t y = 0; y < input_h; y++) {
+                const uint8_t* src = img_src.ptr<uint8_t>(y);
+                float* dst0 = blob + (0 * input_h + y) * input_w;
+                float* dst1 = blob + (1 * input_h + y) * input_w;
+                float* dst2 = blob + (2 * input_h + y) * input_w;
+                for (int32_t x = 0; x < input_w; x++) {
+                    dst0[x] = src[x * 3 + 0] * (1.0f / 255.0f);
+                    dst1[x] = src[x * 3 + 1] * (1.0f / 255.0f);
+                    dst2[x] = src[x * 3 + 2] * (1.0f / 255.0f);
+                }
+            }
+        }
+        InputTensorInfo& tile_input_tensor_info = tile_session.input_tensor_info_list[0];
+        tile_input_tensor_info.data = tile_blob_.data();
+        tile_input_tensor_info.data_type = InputTensorInfo::kDataTypeBlobNchw;
+        if (tile_session.inference_helper->PreProcess(tile_session.input_tensor_info_list) != InferenceHelper::kRetOk) {
+            return kRetErr;
+        }
+        const auto& t_pre_process_batch1 = std::chrono::steady_clock::now();
+
+        /*** Inference ***/
+        const auto& t_inference_batch0 = std::chrono::steady_clock::now();
+        if (tile_session.inference_helper->Process(tile_session.output_tensor_info_list) != InferenceHelper::kRetOk) {
+            return kRetErr;
+        }
+        const auto& t_inference_batch1 = std::chrono::steady_clock::now();
+
+        /*** PostProcess ***/
+        /* Decode each tile with its offset */
+        const auto& t_post_process_batch0 = std::chrono::steady_clock::now();
+        const float* output_data = tile_session.output_tensor_info_list[0].GetDataAsFloat();
+        const int32_t anchor_box_num = tile_session.output_tensor_info_list[0].tensor_dims[1];
+        for (int32_t i = 0; i < num_tile_in_batch; i++) {
+            const cv::Rect& tile = tile_list[tile_index_start + i];
+            std::vector<BoundingBox> bbox_tile_list;
+            float scale_x = static_cast<float>(tile.width) / input_w;
+            float scale_y = static_cast<float>(tile.height) / input_h;
+            GetBoundingBox(output_data + static_cast<size_t>(i) * anchor_box_num * kElementNumOfAnchor, anchor_box_num, scale_x, scale_y, bbox_tile_list);
+            for (auto& bbox : bbox_tile_list) {
+                bbox.x += tile.x;
+                bbox.y += tile.y;
+                bbox_list.push_back(bbox);
+                is_cut_list.push_back(IsCutAtTileBorder(bbox, tile, original_mat.size(), kTileBorderMargin));
+            }
+        }
+        const auto& t_post_process_batch1 = std::chrono::steady_clock::now();
+
+        time_pre_process += static_cast<std::chrono::duration<double>>(t_pre_process_batch1 - t_pre_process_batch0).count() * 1000.0;
+        time_inference += static_cast<std::chrono::duration<double>>(t_inference_batch1 - t_inference_batch0).count() * 1000.0;
+        time_post_process += static_cast<std::chrono::duration<double>>(t_post_process_batch1 - t_post_process_batch0).count() * 1000.0;
+    }
+
+    /*** PostProcess ***/
+    /* Cross-tile NMS */
+    const auto& t_post_process0 = std::chrono::steady_clock::now();
+    for (auto& bbox : bbox_list) {
+        bbox.label = session_set->label_list[bbox.class_id];
+    }
+    std::vector<BoundingBox> bbox_nms_list;
+    MergeTileBoundingBox(bbox_list, is_cut_list, bbox_nms_list);
+    const auto& t_post_process1 = std::chrono::steady_clock::now();
+    time_post_process += static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
+
+    /* Return the results */
+    result.bbox_list = bbox_nms_list;
+    result.crop.x = 0;
+    result.crop.y = 0;
+    result.crop.w = original_mat.cols;
+    result.crop.h = original_mat.rows;
+    result.time_pre_process = time_pre_process;
+    result.time_inference = time_inference;
+    result.time_post_process = time_post_process;
+
+    return kRetOk;
+}
+
+
 int32_t DetectionEngine::ReadLabel(const std::string& filename, std::vector<std::string>& label_list)
 {
     std::ifstream ifs(filename);
@@ -22,6 +22,9 @@ limitations under the License.
 #include <vector>
 #include <array>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -54,35 +57,145 @@ public:
         {}
     } Result;
 
+    typedef struct ModelConfig_ {
+        typedef struct Model_ {
+            std::string name;
+            int32_t     height;
+            int32_t     width;
+        } Model;
+        std::vector<Model> model_list;      /* from low resolution to high resolution. Models which don't exist are skipped */
+        int32_t     default_model_index;    /* used when the latency controller is disabled */
+        std::string input_name;
+        std::string output_name;
+        std::string label_name;
+        bool        is_tile_session_created;    /* create the session for sliced inference (best effort. sliced inference is not available if it fails) */
+        ModelConfig_() : default_model_index(0), is_tile_session_created(true) {}
+    } ModelConfig;
+
 public:
     DetectionEngine() {
         threshold_box_confidence_ = 0.2f;
         threshold_class_confidence_ = 0.2f;
         threshold_nms_iou_ = 0.6f;
+        num_threads_ = 1;
+        session_index_ = 0;
+        latency_budget_ = 0;
+        latency_average_ = 0;
+        cnt_since_switch_ = 0;
+        tile_overlap_ = 64;
+        is_skip_empty_tile_ = false;
+        is_reloading_ = false;
+        reload_cnt_ = 0;
+    }
+    ~DetectionEngine() {
+        if (reload_thread_.joinable()) reload_thread_.join();
     }
-    ~DetectionEngine() {}
-    int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
+    static ModelConfig CreateDefaultModelConfig(void);
+    /* Overwrite model_config with the values in the config file ("key=value" lines). Keys which are not in the file are kept */
+    /*   model0=name height width, model1=..., default_model_index=n, input_name=s, output_name=s, label_name=s */
+    static int32_t ReadModelConfig(const std::string& filename, ModelConfig& model_config);
+    /* One label per line. Also used to get the label table without creating the sessions */
+    static int32_t ReadLabel(const std::string& filename, std::vector<std::string>& label_list);
+    int32_t Initialize(const std::string& work_dir, const int32_t num_threads, const ModelConfig& model_config = CreateDefaultModelConfig());
     int32_t Finalize(void);
+    /* Warm up all the resolutions */
+    int32_t Warmup(int32_t iterations);
+    /* Warm up the session for tiles. Call when sliced inference is turned on */
+    int32_t WarmupSliced(int32_t iterations);
+    /* Load the models on a background thread. They are swapped in between frames when ready, and the current ones are used until then */
+    int32_t Reload(const ModelConfig& model_config);
+    bool IsReloading(void) const { return is_reloading_; }
+    /* Incremented when the reloaded models are swapped in (GetLabelList may be changed) */
+    int32_t GetReloadCount(void) const { return reload_cnt_; }
     int32_t Process(const cv::Mat& original_mat, Result& result);
+    /* Detect in ROI only. ROI is expanded to the aspect ratio of the model input */
+    int32_t Process(const cv::Mat& original_mat, const cv::Rect& roi, Result& result);
+    /* Sliced inference: split the frame into overlapping model-sized tiles and run them as batches */
+    /* The full frame is processed as Process if the session for tiles is not created (IsSlicedInferenceAvailable) */
+    int32_t ProcessSliced(const cv::Mat& original_mat, Result& result);
+    bool IsSlicedInferenceAvailable(void) const { return session_set_ && session_set_->tile_session.inference_helper; }
     void SetThreshold(float threshold_box_confidence, float threshold_class_confidence, float threshold_nms_iou) {
         threshold_box_confidence_ = threshold_box_confidence;
         threshold_class_confidence_ = threshold_class_confidence;
         threshold_nms_iou_ = threshold_nms_iou;
     }
+    /* is_skip_empty_tile: run a low-res full-frame pass first, and skip tiles where nothing is detected by the pass */
+    void SetSlicedInference(int32_t tile_overlap, bool is_skip_empty_tile) {
+        tile_overlap_ = tile_overlap;
+        is_skip_empty_tile_ = is_skip_empty_tile;
+    }
+    /* Resolution (model) is switched per frame to keep the latency within the budget. 0 = disabled (use the default resolution) */
+    void SetLatencyBudget(double latency_budget);
+    int32_t GetResolutionLevel(void) const { return session_index_; }
+    int32_t GetResolutionNum(void) const { return static_cast<int32_t>(session_set_->session_list.size()); }
+    const std::string& GetModelName(void) const { return session_set_->session_list[session_index_].model_name; }
+    const std::vector<std::string>& GetLabelList(void) const { return session_set_->label_list; }
+    /* Input size of the model at the current resolution level */
+    int32_t GetInputWidth(void) const { return session_set_->session_list[session_index_].input_tensor_info_list[0].GetWidth(); }
+    int32_t GetInputHeight(void) const { return session_set_->session_list[session_index_].input_tensor_info_list[0].GetHeight(); }
+
+private:
+    typedef struct Session_ {
+        std::string model_name;
+        std::unique_ptr<InferenceHelper> inference_helper;
+        std::vector<InputTensorInfo> input_tensor_info_list;
+        std::vector<OutputTensorInfo> output_tensor_info_list;
+    } Session;
+
+    /* All the sessions created from a model config. Replaced at once by Reload */
+    typedef struct SessionSet_ {
+        ModelConfig model_config;
+        std::vector<Session> session_list;      /* from low resolution to high resolution */
+        int32_t default_session_index;
+        std::vector<std::string> label_list;
+        Session tile_session;                   /* for sliced inference (batch = kTileBatchSize). inference_helper is null if not created */
+        SessionSet_() : default_session_index(0) {}
+        ~SessionSet_();
+    } SessionSet;
+
+    static constexpr int32_t kTileBatchSize = 4;
+    static constexpr int32_t kTileBorderMargin = 2;         /* [px] box within this distance from the inner tile border is regarded as cut */
+    static constexpr float kThresholdTileMergeOverlap = 0.6f;  /* intersection / area of the smaller box, to merge boxes cut at tile border */
+    static constexpr int32_t kMinFrameToSwitch = 10;        /* hysteresis: keep the resolution at least this number of frames */
+    static constexpr double kLatencyRatioDown = 1.0;        /* step down when latency > budget * kLatencyRatioDown */
+    static constexpr double kLatencyRatioUp = 0.8;          /* step up when expected latency < budget * kLatencyRatioUp */
 
 private:
-    int32_t ReadLabel(const std::string& filename, std::vector<std::string>& label_list);
     void GetBoundingBox(const float* data, int32_t anchor_box_num, float scale_x, float  scale_y, std::vector<BoundingBox>& bbox_list);
+    int32_t CreateSession(const ModelConfig& model_config, const ModelConfig::Model& model, int32_t batch, Session& session);
+    int32_t CreateSessionSet(const ModelConfig& model_config, std::shared_ptr<SessionSet>& session_set);
+    void SwapSessionSet(void);
+    int32_t ProcessRoi(SessionSet& session_set, int32_t session_index, const cv::Mat& original_mat, const cv::Rect& roi, Result& result);
+    cv::Rect AdjustRoi(const cv::Rect& roi, const cv::Size& image_size, const cv::Size& input_size) const;
+    void UpdateResolutionLevel(const SessionSet& session_set, double latency);
+    void MergeTileBoundingBox(std::vector<BoundingBox>& bbox_list, const std::vector<bool>& is_cut_list, std::vector<BoundingBox>& bbox_merged_list);
 
 private:
-    std::unique_ptr<InferenceHelper> inference_helper_;
-    std::vector<InputTensorInfo> input_tensor_info_list_;
-    std::vector<OutputTensorInfo> output_tensor_info_list_;
-    std::vector<std::string> label_list_;
+    std::shared_ptr<SessionSet> session_set_;
+    std::shared_ptr<SessionSet> session_set_reloaded_;  /* created by the reload thread */
+    std::mutex reload_mutex_;                           /* for session_set_reloaded_ */
+    std::thread reload_thread_;
+    std::atomic<bool> is_reloading_;
+    int32_t reload_cnt_;
 
     float threshold_box_confidence_;
     float threshold_class_confidence_;
     float threshold_nms_iou_;
+
+    std::string work_dir_;
+    int32_t num_threads_;
+
+    /* Latency controller */
+    int32_t session_index_;
+    double latency_budget_;                 /* [msec] */
+    double latency_average_;                /* [msec] of the current resolution */
+    std::vector<double> latency_list_;      /* [msec] last measured latency of each resolution. 0 = not measured */
+    int32_t cnt_since_switch_;
+
+    /* for sliced inference */
+    int32_t tile_overlap_;
+    bool is_skip_empty_tile_;
+    std::vector<float> tile_blob_;
 };
 
 #endif
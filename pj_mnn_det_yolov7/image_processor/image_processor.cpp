@@ -36,15 +36,41 @@ limitations under the License.
 #include "detection_engine.h"
 #include "tracker.h"
 #include "image_processor.h"
+#include "video_chunk_processor.h"
 
 /*** Macro ***/
 #define TAG "ImageProcessor"
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+static constexpr int32_t kTileOverlap = 64;
+static constexpr int32_t kIntervalFullFrameScan = 10;   /* to find new objects in tracker-guided ROI mode */
+static constexpr float kRoiMarginRatio = 0.2f;          /* margin around the predicted position of each track */
+static constexpr int32_t kRoiMarginMin = 32;
+static constexpr double kLatencyBudget = 33.0;           /* [msec] for resolution switching */
+static constexpr int32_t kChunkOverlapFrame = 30;        /* overlapping frames b/w chunks to stitch track IDs */
+#define MODEL_CONFIG_NAME "model_config_yolov7.txt"     /* in the model directory. Optional */
+
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_engine;
+std::string s_work_dir;
 Tracker s_tracker;
+bool s_is_sliced_inference = false;
+bool s_is_skip_empty_tile = false;
+bool s_is_tracker_guided_roi = false;
+FrameSkipController s_frame_skip_controller;
+bool s_is_adaptive_resolution = false;
+int32_t s_reload_cnt = 0;
+std::vector<std::string> s_label_list;  /* to find the change of the label table by reload */
+
+/* The latest result for drawing. Draw can be called at a lower rate than Analyze */
+static bool s_is_detection_frame = false;
+static DetectionEngine::Result s_det_result;
+
+/* Text drawn in every frame. Glyphs and texts are cached in each renderer */
+static CommonHelper::TextRenderer s_text_renderer_fps(0.5, 2);
+static CommonHelper::TextRenderer s_text_renderer_label(0.35, 1);
+static CommonHelper::TextRenderer s_text_renderer_info(0.7, 2);
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -55,7 +81,7 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
     double fps = 1e9 / (time_now - time_previous).count();
     time_previous = time_now;
     snprintf(text, sizeof(text), "FPS: %.1f, Inference: %.1f [ms]", fps, time_inference);
-    CommonHelper::DrawText(mat, text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
+    s_text_renderer_fps.Draw(mat, text, cv::Point(0, 0), CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true, false);
 }
 
 static cv::Scalar GetColorForId(int32_t id)
@@ -71,6 +97,38 @@ static cv::Scalar GetColorForId(int32_t id)
     return color_list[id % kMaxNum];
 }
 
+/* Union of the predicted positions of tracks at timestamp with margin */
+static bool CalculateTrackerRoi(const cv::Size& image_size, double timestamp, cv::Rect& roi)
+{
+    /* Tracks may not be updated for several frames (e.g. skipped frames) */
+    const double dt = s_tracker.GetElapsedFrame(timestamp);
+    bool is_found = false;
+    for (const auto& track : s_tracker.GetTrackList()) {
+        const BoundingBox bbox = track.GetPredictedBoundingBox(dt);
+        const int32_t margin = (std::max)(kRoiMarginMin, static_cast<int32_t>((std::max)(bbox.w, bbox.h) * kRoiMarginRatio));
+        cv::Rect rect(bbox.x - margin, bbox.y - margin, bbox.w + margin * 2, bbox.h + margin * 2);
+        roi = is_found ? (roi | rect) : rect;
+        is_found = true;
+    }
+    if (!is_found) return false;
+    roi &= cv::Rect(0, 0, image_size.width, image_size.height);
+    return roi.area() > 0;
+}
+
+/* The default model config is overwritten by the config file if it exists, so that another model can be used without rebuild */
+static int32_t CreateModelConfig(const std::string& work_dir, DetectionEngine::ModelConfig& model_config)
+{
+    model_config = DetectionEngine::CreateDefaultModelConfig();
+    const std::string filename = work_dir + "/model/" + MODEL_CONFIG_NAME;
+    std::ifstream ifs(filename);
+    if (ifs.fail()) return 0;
+    if (DetectionEngine::ReadModelConfig(filename, model_config) != DetectionEngine::kRetOk) {
+        return -1;
+    }
+    PRINT("Model config: %s\n", filename.c_str());
+    return 0;
+}
+
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
     if (s_engine) {
@@ -78,12 +136,42 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
+    s_work_dir = input_param.work_dir;
+    DetectionEngine::ModelConfig model_config;
+    if (CreateModelConfig(s_work_dir, model_config) != 0) {
+        return -1;
+    }
     s_engine.reset(new DetectionEngine());
-    if (s_engine->Initialize(input_param.work_dir, input_param.num_threads) != DetectionEngine::kRetOk) {
+    if (s_engine->Initialize(input_param.work_dir, input_param.num_threads, model_config) != DetectionEngine::kRetOk) {
         s_engine->Finalize();
         s_engine.reset();
         return -1;
     }
+    s_reload_cnt = s_engine->GetReloadCount();
+    s_label_list = s_engine->GetLabelList();
+    return 0;
+}
+
+int32_t ImageProcessor::Warmup(int32_t iterations)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+
+    if (s_engine->Warmup(iterations) != DetectionEngine::kRetOk) {
+        return -1;
+    }
+    return 0;
+}
+
+int32_t ImageProcessor::SetFrameRate(double fps)
+{
+    if (fps <= 0) {
+        PRINT_E("Invalid frame rate (%f)\n", fps);
+        return -1;
+    }
+    s_tracker.SetFrameInterval(1.0 / fps);
     return 0;
 }
 
@@ -111,6 +199,50 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
     switch (cmd) {
     case 0:
+        /* Toggle sliced inference (for small objects in high resolution image) */
+        if (!s_is_sliced_inference) {
+            if (!s_engine->IsSlicedInferenceAvailable()) {
+                PRINT_E("Sliced inference is not available\n");
+                return -1;
+            }
+            /* The session for tiles is warmed up only when it's used */
+            s_engine->WarmupSliced(1);
+        }
+        s_is_sliced_inference = !s_is_sliced_inference;
+        PRINT("Sliced inference: %s\n", s_is_sliced_inference ? "ON" : "OFF");
+        return 0;
+    case 1:
+        /* Toggle skipping tiles where nothing is found by the low-res full-frame pass */
+        s_is_skip_empty_tile = !s_is_skip_empty_tile;
+        s_engine->SetSlicedInference(kTileOverlap, s_is_skip_empty_tile);
+        PRINT("Skip empty tile: %s\n", s_is_skip_empty_tile ? "ON" : "OFF");
+        return 0;
+    case 2:
+        /* Toggle detection only around the predicted position of tracks */
+        s_is_tracker_guided_roi = !s_is_tracker_guided_roi;
+        PRINT("Tracker-guided ROI: %s\n", s_is_tracker_guided_roi ? "ON" : "OFF");
+        return 0;
+    case 3:
+        /* Toggle adaptive frame skip (detection every k frames, tracker prediction only in-between frames) */
+        s_frame_skip_controller.SetEnabled(!s_frame_skip_controller.IsEnabled());
+        PRINT("Adaptive frame skip: %s\n", s_frame_skip_controller.IsEnabled() ? "ON" : "OFF");
+        return 0;
+    case 4:
+        /* Toggle resolution switching to keep the latency within the budget */
+        s_is_adaptive_resolution = !s_is_adaptive_resolution;
+        s_engine->SetLatencyBudget(s_is_adaptive_resolution ? kLatencyBudget : 0);
+        PRINT("Adaptive resolution: %s\n", s_is_adaptive_resolution ? "ON" : "OFF");
+        return 0;
+    case 5:
+        /* Reload the models with the config file (MODEL_CONFIG_NAME) read again. Processing continues with the current models until the new ones are ready */
+        {
+            DetectionEngine::ModelConfig model_config;
+            if (CreateModelConfig(s_work_dir, model_config) != 0 || s_engine->Reload(model_config) != DetectionEngine::kRetOk) {
+                return -1;
+            }
+        }
+        PRINT("Reloading models\n");
+        return 0;
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
         return -1;
@@ -119,7 +251,90 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
 
 
-int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
+int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result, double timestamp)
+{
+    if (Analyze(mat, result, timestamp) != 0) {
+        return -1;
+    }
+    return Draw(mat);
+}
+
+
+int32_t ImageProcessor::Analyze(const cv::Mat& mat, ImageProcessor::Result& result, double timestamp)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+
+    /* In adaptive frame skip mode, detection runs every few frames */
+    const bool is_detection_frame = s_frame_skip_controller.IsDetectionFrame();
+
+    DetectionEngine::Result det_result;
+    if (is_detection_frame) {
+        /* Scan the full frame periodically to find new objects even in tracker-guided ROI mode */
+        static int32_t s_frame_cnt = 0;
+        cv::Rect roi(0, 0, mat.cols, mat.rows);
+        if (s_is_tracker_guided_roi && s_frame_cnt % kIntervalFullFrameScan != 0) {
+            if (!CalculateTrackerRoi(mat.size(), timestamp, roi)) {
+                roi = cv::Rect(0, 0, mat.cols, mat.rows);
+            }
+        }
+        s_frame_cnt++;
+
+        if (s_is_sliced_inference) {
+            if (s_engine->ProcessSliced(mat, det_result) != DetectionEngine::kRetOk) {
+                return -1;
+            }
+        } else {
+            if (s_engine->Process(mat, roi, det_result) != DetectionEngine::kRetOk) {
+                return -1;
+            }
+        }
+    }
+
+    /* Update tracker */
+    s_frame_skip_controller.UpdateTracker(s_tracker, is_detection_frame, det_result.bbox_list, det_result.time_pre_process + det_result.time_inference + det_result.time_post_process, timestamp);
+
+    /* Return the results */
+    const auto& track_list = s_tracker.GetTrackList();
+    result.object_list.resize(track_list.size());   /* no reallocation unless the number exceeds the capacity */
+    for (size_t i = 0; i < track_list.size(); i++) {
+        const auto& track = track_list[i];
+        const auto& bbox = track.GetLatestData().bbox;
+        auto& object = result.object_list[i];
+        object.track_id = track.GetId();
+        object.class_id = bbox.class_id;
+        object.score = bbox.score;
+        object.x = bbox.x;
+        object.y = bbox.y;
+        object.width = bbox.w;
+        object.height = bbox.h;
+    }
+
+    result.time_pre_process = det_result.time_pre_process;
+    result.time_inference = det_result.time_inference;
+    result.time_post_process = det_result.time_post_process;
+
+    /* The label table may be changed by reload */
+    result.is_label_list_changed = false;
+    if (s_engine->GetReloadCount() != s_reload_cnt) {
+        s_reload_cnt = s_engine->GetReloadCount();
+        if (s_engine->GetLabelList() != s_label_list) {
+            s_label_list = s_engine->GetLabelList();
+            result.is_label_list_changed = true;
+        }
+    }
+
+    /* Keep the result for Draw */
+    s_is_detection_frame = is_detection_frame;
+    s_det_result = std::move(det_result);
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::Detect(const cv::Mat& mat, ImageProcessor::Result& result)
 {
     if (!s_engine) {
         PRINT_E("Not initialized\n");
@@ -131,8 +346,90 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    result.object_list.resize(det_result.bbox_list.size());
+    for (size_t i = 0; i < det_result.bbox_list.size(); i++) {
+        const auto& bbox = det_result.bbox_list[i];
+        auto& object = result.object_list[i];
+        object.track_id = -1;
+        object.class_id = bbox.class_id;
+        object.score = bbox.score;
+        object.x = bbox.x;
+        object.y = bbox.y;
+        object.width = bbox.w;
+        object.height = bbox.h;
+    }
+    result.time_pre_process = det_result.time_pre_process;
+    result.time_inference = det_result.time_inference;
+    result.time_post_process = det_result.time_post_process;
+    result.is_label_list_changed = false;
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::ProcessVideo(const InputParam& input_param, const std::string& filename, int32_t chunk_num, const VideoResultCallback& callback)
+{
+    DetectionEngine::ModelConfig model_config;
+    if (CreateModelConfig(input_param.work_dir, model_config) != 0) {
+        return -1;
+    }
+    VideoChunkProcessor processor;
+    if (processor.Process(input_param.work_dir, model_config, filename, chunk_num, kChunkOverlapFrame, input_param.num_threads, callback) != VideoChunkProcessor::kRetOk) {
+        return -1;
+    }
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetDefaultLabelList(const InputParam& input_param, std::vector<std::string>& label_list)
+{
+    DetectionEngine::ModelConfig model_config;
+    if (CreateModelConfig(input_param.work_dir, model_config) != 0) {
+        return -1;
+    }
+    const std::string filename = std::string(input_param.work_dir) + "/model/" + model_config.label_name;
+    if (DetectionEngine::ReadLabel(filename, label_list) != DetectionEngine::kRetOk) {
+        return -1;
+    }
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetInputSize(int32_t& width, int32_t& height)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+    width = s_engine->GetInputWidth();
+    height = s_engine->GetInputHeight();
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetLabelList(std::vector<std::string>& label_list)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+    label_list = s_engine->GetLabelList();
+    return 0;
+}
+
+
+int32_t ImageProcessor::Draw(cv::Mat& mat)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+    const DetectionEngine::Result& det_result = s_det_result;
+
     /* Display target area  */
-    cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
+    if (s_is_detection_frame) {
+        cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
+    }
 
     /* Display detection result (black rectangle) */
     int32_t num_det = 0;
@@ -142,7 +439,6 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /* Display tracking result  */
-    s_tracker.Update(det_result.bbox_list);
     int32_t num_track = 0;
     auto& track_list = s_tracker.GetTrackList();
     for (auto& track : track_list) {
@@ -151,7 +447,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         /* Use white rectangle for the object which was not detected but just predicted */
         cv::Scalar color = bbox.score == 0 ? CommonHelper::CreateCvColor(255, 255, 255) : GetColorForId(track.GetId());
         cv::rectangle(mat, cv::Rect(bbox.x, bbox.y, bbox.w, bbox.h), color, 2);
-        CommonHelper::DrawText(mat, std::to_string(track.GetId()) + ": " + bbox.label, cv::Point(bbox.x, bbox.y), 0.35, 1, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
+        s_text_renderer_label.Draw(mat, std::to_string(track.GetId()) + ": " + bbox.label, cv::Point(bbox.x, bbox.y), CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
 
         auto& track_history = track.GetDataHistory();
         for (size_t i = 1; i < track_history.size(); i++) {
@@ -161,30 +457,9 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         }
         num_track++;
     }
-    CommonHelper::DrawText(mat, "DET: " + std::to_string(num_det) + ", TRACK: " + std::to_string(num_track), cv::Point(0, 20), 0.7, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
+    s_text_renderer_info.Draw(mat, "DET: " + std::to_string(num_det) + ", TRACK: " + std::to_string(num_track), cv::Point(0, 20), CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
 
     DrawFps(mat, det_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 
-    /* Return the results */
-    int32_t bbox_num = 0;
-    for (auto& track : track_list) {
-        const auto& bbox = track.GetLatestData().bbox;
-        result.object_list[bbox_num].class_id = bbox.class_id;
-        snprintf(result.object_list[bbox_num].label, sizeof(result.object_list[bbox_num].label), "%s", bbox.label.c_str());
-        result.object_list[bbox_num].score = bbox.score;
-        result.object_list[bbox_num].x = bbox.x;
-        result.object_list[bbox_num].y = bbox.y;
-        result.object_list[bbox_num].width = bbox.w;
-        result.object_list[bbox_num].height = bbox.h;
-        bbox_num++;
-        if (bbox_num >= NUM_MAX_RESULT) break;
-    }
-    result.object_num = bbox_num;
-
-    result.time_pre_process = det_result.time_pre_process;
-    result.time_inference = det_result.time_inference;
-    result.time_post_process = det_result.time_post_process;
-
     return 0;
 }
-
@@ -21,13 +21,12 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <functional>
 
 namespace cv {
     class Mat;
 };
 
-#define NUM_MAX_RESULT 100
-
 namespace ImageProcessor
 {
 
@@ -36,26 +35,63 @@ typedef struct {
     int32_t  num_threads;
 } InputParam;
 
+/* POD, so that object_list can be serialized as it is */
 typedef struct {
-    int32_t object_num;
-    struct {
-        int32_t  class_id;
-        char     label[256];
-        double   score;
-        int32_t  x;
-        int32_t  y;
-        int32_t  width;
-        int32_t  height;
-    } object_list[NUM_MAX_RESULT];
+    int32_t  track_id;
+    int32_t  class_id;  // index of the label table (GetLabelList)
+    float    score;
+    int32_t  x;
+    int32_t  y;
+    int32_t  width;
+    int32_t  height;
+} Object;
+
+typedef struct {
+    std::vector<Object> object_list;    // all objects (not truncated). Reuse the same Result across frames to avoid reallocation
     double time_pre_process;   // [msec]
     double time_inference;    // [msec]
     double time_post_process;  // [msec]
+    bool   is_label_list_changed;   // GetLabelList is changed by model reload since the previous result. class_id of this result is for the new table
 } Result;
 
+/* Binary record of a frame: RecordHeader followed by Object * object_num (native byte order) */
+/* When the label table is changed, RecordHeader with frame = kRecordLabelTable and object_num = 0 is followed by the new label table */
+static constexpr int32_t kRecordLabelTable = -1;
+typedef struct {
+    int32_t frame;
+    int32_t object_num;
+    double  time_pre_process;   // [msec]
+    double  time_inference;     // [msec]
+    double  time_post_process;  // [msec]
+} RecordHeader;
+
 int32_t Initialize(const InputParam& input_param);
-int32_t Process(cv::Mat& mat, Result& result);
+/* timestamp [sec]: time of the frame (e.g. position in the video file) for the tracker. 1 frame interval is assumed if not given (< 0) */
+/* Analyze and Draw */
+int32_t Process(cv::Mat& mat, Result& result, double timestamp = -1.0);
+/* Return the structured result only. Nothing is drawn on mat */
+int32_t Analyze(const cv::Mat& mat, Result& result, double timestamp = -1.0);
+/* Detection only for independent images (e.g. batch of still images). Tracker is not used (track_id = -1) and nothing is drawn */
+int32_t Detect(const cv::Mat& mat, Result& result);
+/* Called for each frame of ProcessVideo in the order of frame */
+typedef std::function<void(int32_t frame, const Result& result)> VideoResultCallback;
+/* Offline processing of a video file. The file is split into chunk_num time chunks processed in parallel, and track IDs are stitched across chunks */
+/* Initialize is not needed because engines are created for each chunk. The results of a chunk are given to callback as soon as its track IDs are stitched */
+int32_t ProcessVideo(const InputParam& input_param, const std::string& filename, int32_t chunk_num, const VideoResultCallback& callback);
+/* Label table of the model used by ProcessVideo (default model config, or the config file). Initialize is not needed */
+int32_t GetDefaultLabelList(const InputParam& input_param, std::vector<std::string>& label_list);
+/* Draw the result of the latest Analyze on mat. Can be called at a lower rate than Analyze */
+int32_t Draw(cv::Mat& mat);
+/* Label table for Object::class_id. It may be changed by reloading the model */
+int32_t GetLabelList(std::vector<std::string>& label_list);
+/* Input size of the model. Images larger than this are resized in pre-process */
+int32_t GetInputSize(int32_t& width, int32_t& height);
+/* Frame rate of the source, which is the unit of time for the tracker */
+int32_t SetFrameRate(double fps);
 int32_t Finalize(void);
 int32_t Command(int32_t cmd);
+/* Run the engines with synthetic images (CommonHelper::RunWarmup). Call after Initialize */
+int32_t Warmup(int32_t iterations = 2);
 
 }
 
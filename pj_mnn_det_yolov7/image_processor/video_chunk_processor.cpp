@@ -0,0 +1,298 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "common_helper_cv.h"
+#include "bounding_box.h"
+#include "detection_engine.h"
+#include "tracker.h"
+#include "hungarian_algorithm.h"
+#include "image_processor.h"
+#include "video_chunk_processor.h"
+
+/*** Macro ***/
+#define TAG "VideoChunkProcessor"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+static constexpr int32_t kCaptureBufferNum = 4;
+
+/*** Function ***/
+static BoundingBox Object2BoundingBox(const ImageProcessor::Object& object)
+{
+    return BoundingBox(object.class_id, "", object.score, object.x, object.y, object.width, object.height);
+}
+
+int32_t VideoChunkProcessor::Process(const std::string& work_dir, const DetectionEngine::ModelConfig& model_config, const std::string& filename, int32_t chunk_num, int32_t overlap_frame_num, int32_t num_threads, const ImageProcessor::VideoResultCallback& callback)
+{
+    if (chunk_num <= 0 || overlap_frame_num < 0) {
+        PRINT_E("Invalid parameter\n");
+        return kRetErr;
+    }
+
+    cv::VideoCapture cap(filename);
+    if (!cap.isOpened()) {
+        PRINT_E("Unable to open %s\n", filename.c_str());
+        return kRetErr;
+    }
+    const int32_t frame_num = static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    cap.release();
+    if (frame_num <= 0) {
+        PRINT_E("Unable to get the number of frames of %s\n", filename.c_str());
+        return kRetErr;
+    }
+    if (fps <= 0) fps = 30.0;
+
+    /*** Split into chunks ***/
+    /* Too short chunks are meaningless because the overlap is processed twice */
+    chunk_num = (std::max)(1, (std::min)(chunk_num, frame_num / (std::max)(1, overlap_frame_num * 2)));
+    std::vector<Chunk> chunk_list(chunk_num);
+    for (int32_t i = 0; i < chunk_num; i++) {
+        Chunk& chunk = chunk_list[i];
+        chunk.frame_range_start = static_cast<int32_t>(static_cast<int64_t>(frame_num) * i / chunk_num);
+        chunk.frame_start = (std::max)(0, chunk.frame_range_start - (i > 0 ? overlap_frame_num : 0));
+        /* The last chunk reads until the end of stream, because CAP_PROP_FRAME_COUNT may be an estimate */
+        chunk.frame_end = (i == chunk_num - 1) ? INT32_MAX : static_cast<int32_t>(static_cast<int64_t>(frame_num) * (i + 1) / chunk_num);
+    }
+
+    /*** Process chunks in parallel. Each chunk has its own decoder, engine and tracker ***/
+    const auto time_start = std::chrono::steady_clock::now();
+    const int32_t num_threads_per_chunk = (std::max)(1, num_threads / chunk_num);
+    /* Only the default resolution is used, so the other resolutions and the session for tiles are not created */
+    DetectionEngine::ModelConfig model_config_chunk = model_config;
+    model_config_chunk.model_list = { model_config.model_list[model_config.default_model_index] };
+    model_config_chunk.default_model_index = 0;
+    model_config_chunk.is_tile_session_created = false;
+    std::vector<std::thread> thread_list;
+    for (auto& chunk : chunk_list) {
+        thread_list.push_back(std::thread(&VideoChunkProcessor::ProcessChunk, std::cref(work_dir), std::cref(model_config_chunk), std::cref(filename), fps, num_threads_per_chunk, std::ref(chunk)));
+    }
+
+    /*** Stitch track IDs at each boundary and give the results in order, as soon as each chunk is done ***/
+    int32_t ret = kRetOk;
+    int32_t global_id_next = 0;
+    std::map<int32_t, int32_t> id_map_prev;
+    ImageProcessor::Result result;  /* reused across frames */
+    for (int32_t i = 0; i < chunk_num; i++) {
+        thread_list[i].join();
+        Chunk& chunk = chunk_list[i];
+        if (ret != kRetOk) continue;    /* just wait for the remaining threads */
+        if (chunk.ret != kRetOk) {
+            ret = kRetErr;
+            continue;
+        }
+
+        std::map<int32_t, int32_t> id_map;  /* unmatched tracks get new IDs below */
+        if (i > 0) {
+            StitchTrack(chunk_list[i - 1], id_map_prev, chunk, id_map);
+            /* The results of the previous chunk are not needed any more */
+            std::vector<ImageProcessor::Result>().swap(chunk_list[i - 1].result_list);
+        }
+
+        /* The results in the chunk are kept with the local track IDs, because they are used to stitch with the next chunk */
+        const int32_t index_start = (std::min)((std::max)(0, chunk.frame_range_start - chunk.frame_start), static_cast<int32_t>(chunk.result_list.size()));
+        for (int32_t index = index_start; index < static_cast<int32_t>(chunk.result_list.size()); index++) {
+            result = chunk.result_list[index];
+            for (auto& object : result.object_list) {
+                auto it = id_map.find(object.track_id);
+                if (it == id_map.end()) {
+                    it = id_map.insert(std::make_pair(object.track_id, global_id_next++)).first;
+                }
+                object.track_id = it->second;
+            }
+            callback(chunk.frame_start + index, result);
+        }
+        id_map_prev.swap(id_map);
+    }
+    if (ret != kRetOk) return kRetErr;
+
+    const double time_elapsed = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - time_start).count();
+    PRINT("%d chunks, %.1f [sec]\n", chunk_num, time_elapsed);
+    return kRetOk;
+}
+
+
+void VideoChunkProcessor::ProcessChunk(const std::string& work_dir, const DetectionEngine::ModelConfig& model_config, const std::string& filename, double fps, int32_t num_threads, Chunk& chunk)
+{
+    chunk.ret = kRetErr;
+
+    DetectionEngine engine;
+    if (engine.Initialize(work_dir, num_threads, model_config) != DetectionEngine::kRetOk) {
+        engine.Finalize();
+        return;
+    }
+
+    cv::VideoCapture cap(filename);
+    if (!cap.isOpened()) {
+        PRINT_E("Unable to open %s\n", filename.c_str());
+        engine.Finalize();
+        return;
+    }
+    if (chunk.frame_start > 0) {
+        cap.set(cv::CAP_PROP_POS_FRAMES, chunk.frame_start);
+    }
+    /* Seeking is not frame accurate on some backends. Use the position the backend reports */
+    const int32_t frame_start = (std::max)(0, static_cast<int32_t>(cap.get(cv::CAP_PROP_POS_FRAMES)));
+    if (frame_start > chunk.frame_range_start) {
+        PRINT_E("Failed to seek to %d (%d)\n", chunk.frame_start, frame_start);
+        engine.Finalize();
+        return;
+    } else if (frame_start > chunk.frame_start) {
+        /* The overlap gets shorter */
+        chunk.frame_start = frame_start;
+    }
+
+    CommonHelper::VideoCaptureAsync cap_async;
+    cap_async.Open(cap, CommonHelper::VideoCaptureAsync::kPolicyEveryFrame, kCaptureBufferNum);
+
+    Tracker tracker;
+    tracker.SetFrameInterval(1.0 / fps);
+    if (chunk.frame_end != INT32_MAX) {
+        chunk.result_list.reserve(chunk.frame_end - chunk.frame_start);
+    }
+
+    /* Frames before chunk.frame_start (when the backend seeks to an earlier position) are skipped */
+    cv::Mat image;
+    for (int32_t frame = frame_start; frame < chunk.frame_end; frame++) {
+        if (!cap_async.Read(image)) break;
+        if (frame < chunk.frame_start) continue;
+
+        DetectionEngine::Result det_result;
+        if (engine.Process(image, det_result) != DetectionEngine::kRetOk) {
+            engine.Finalize();
+            return;
+        }
+        /* Timestamp from the frame index, so that the result doesn't depend on the processing speed */
+        tracker.Update(det_result.bbox_list, frame / fps);
+
+        chunk.result_list.push_back(ImageProcessor::Result());
+        ImageProcessor::Result& result = chunk.result_list.back();
+        const auto& track_list = tracker.GetTrackList();
+        result.object_list.resize(track_list.size());
+        for (size_t i = 0; i < track_list.size(); i++) {
+            const auto& track = track_list[i];
+            const auto& bbox = track.GetLatestData().bbox;
+            auto& object = result.object_list[i];
+            object.track_id = track.GetId();
+            object.class_id = bbox.class_id;
+            object.score = bbox.score;
+            object.x = bbox.x;
+            object.y = bbox.y;
+            object.width = bbox.w;
+            object.height = bbox.h;
+        }
+        result.time_pre_process = det_result.time_pre_process;
+        result.time_inference = det_result.time_inference;
+        result.time_post_process = det_result.time_post_process;
+    }
+    cap_async.Close();
+    engine.Finalize();
+
+    chunk.ret = kRetOk;
+}
+
+
+void VideoChunkProcessor::StitchTrack(const Chunk& chunk_prev, const std::map<int32_t, int32_t>& id_map_prev, const Chunk& chunk, std::map<int32_t, int32_t>& id_map)
+{
+    /*** Collect the tracks in the overlapping frames [chunk.frame_start, chunk.frame_range_start) ***/
+    /* Tracks in the current chunk just after the start are not stable, but they are associated by IoU in the same way as the tracker does */
+    std::map<int32_t, int32_t> index_prev_map;  /* track ID -> index of the cost matrix */
+    std::map<int32_t, int32_t> index_map;
+    std::vector<int32_t> id_prev_list;
+    std::vector<int32_t> id_list;
+    std::map<std::pair<int32_t, int32_t>, float> iou_sum_map;
+    std::map<std::pair<int32_t, int32_t>, int32_t> frame_num_both_map;  /* number of frames where both of the pair exist */
+    std::vector<int32_t> frame_num_prev_list;   /* number of frames where each track exists */
+    std::vector<int32_t> frame_num_list;
+
+    Tracker tracker;    /* for CalculateSimilarity only */
+    for (int32_t frame = chunk.frame_start; frame < chunk.frame_range_start; frame++) {
+        const int32_t index_prev = frame - chunk_prev.frame_start;
+        const int32_t index = frame - chunk.frame_start;
+        if (index_prev < 0 || index_prev >= static_cast<int32_t>(chunk_prev.result_list.size())) continue;
+        if (index >= static_cast<int32_t>(chunk.result_list.size())) break;
+        const auto& object_prev_list = chunk_prev.result_list[index_prev].object_list;
+        const auto& object_list = chunk.result_list[index].object_list;
+
+        for (const auto& object_prev : object_prev_list) {
+            if (index_prev_map.insert(std::make_pair(object_prev.track_id, static_cast<int32_t>(id_prev_list.size()))).second) {
+                id_prev_list.push_back(object_prev.track_id);
+                frame_num_prev_list.push_back(0);
+            }
+            frame_num_prev_list[index_prev_map[object_prev.track_id]]++;
+        }
+        for (const auto& object : object_list) {
+            if (index_map.insert(std::make_pair(object.track_id, static_cast<int32_t>(id_list.size()))).second) {
+                id_list.push_back(object.track_id);
+                frame_num_list.push_back(0);
+            }
+            frame_num_list[index_map[object.track_id]]++;
+        }
+        for (const auto& object_prev : object_prev_list) {
+            const BoundingBox bbox_prev = Object2BoundingBox(object_prev);
+            for (const auto& object : object_list) {
+                const auto key = std::make_pair(index_prev_map[object_prev.track_id], index_map[object.track_id]);
+                frame_num_both_map[key]++;
+                const float iou = Tracker::kCostMax - tracker.CalculateSimilarity(bbox_prev, Object2BoundingBox(object));
+                if (iou > 0) iou_sum_map[key] += iou;
+            }
+        }
+    }
+
+    /*** Association ***/
+    /* Cost = kCostMax - average IoU over the frames where either track exists, so a short coincidental overlap costs high */
+    if (!id_prev_list.empty() && !id_list.empty()) {
+        const size_t size_cost_matrix = (std::max)(id_prev_list.size(), id_list.size());
+        std::vector<std::vector<float>> cost_matrix(size_cost_matrix, std::vector<float>(size_cost_matrix, Tracker::kCostMax));
+        for (const auto& iou_sum : iou_sum_map) {
+            const int32_t i_prev = iou_sum.first.first;
+            const int32_t i = iou_sum.first.second;
+            const int32_t frame_num_union = frame_num_prev_list[i_prev] + frame_num_list[i] - frame_num_both_map[iou_sum.first];
+            cost_matrix[i_prev][i] = Tracker::kCostMax - iou_sum.second / (std::max)(1, frame_num_union);
+        }
+
+        std::vector<int32_t> index_for_prev(size_cost_matrix, -1);
+        std::vector<int32_t> index_prev_for_current(size_cost_matrix, -1);
+        HungarianAlgorithm<float> solver(cost_matrix);
+        solver.Solve(index_for_prev, index_prev_for_current);
+
+        int32_t matched_num = 0;
+        for (size_t i_prev = 0; i_prev < id_prev_list.size(); i_prev++) {
+            const int32_t i = index_for_prev[i_prev];
+            if (i < 0 || i >= static_cast<int32_t>(id_list.size()) || cost_matrix[i_prev][i] >= Tracker::kCostMax) continue;
+            const auto it = id_map_prev.find(id_prev_list[i_prev]);
+            if (it == id_map_prev.end()) continue;  /* not in the output range of the previous chunk */
+            id_map[id_list[i]] = it->second;
+            matched_num++;
+        }
+        PRINT("Stitch at frame %d: %d / %d tracks\n", chunk.frame_range_start, matched_num, static_cast<int32_t>(id_list.size()));
+    }
+}
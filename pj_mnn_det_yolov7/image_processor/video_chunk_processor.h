@@ -0,0 +1,64 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef VIDEO_CHUNK_PROCESSOR_
+#define VIDEO_CHUNK_PROCESSOR_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+/* for My modules */
+#include "image_processor.h"
+#include "detection_engine.h"
+
+
+/* Offline processing of a video file */
+/* The video is split into time chunks, and each chunk is processed in parallel with its own decoder, DetectionEngine and Tracker */
+/* Each chunk (except the first one) starts overlap_frame_num frames earlier than its range, */
+/* and track IDs are stitched by matching the tracks of the adjacent chunks in the overlapping frames */
+class VideoChunkProcessor {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+public:
+    VideoChunkProcessor() {}
+    ~VideoChunkProcessor() {}
+    /* callback is called for each frame in the order of frame. track_id is unique in the whole video */
+    /* The results of a chunk are given as soon as the chunk is done and stitched with the previous chunk, so the whole video is not kept in memory */
+    /* model_config: only the default model is used */
+    int32_t Process(const std::string& work_dir, const DetectionEngine::ModelConfig& model_config, const std::string& filename, int32_t chunk_num, int32_t overlap_frame_num, int32_t num_threads, const ImageProcessor::VideoResultCallback& callback);
+
+private:
+    typedef struct Chunk_ {
+        int32_t frame_start;        /* including the overlap */
+        int32_t frame_range_start;  /* frames before this are the overlap with the previous chunk */
+        int32_t frame_end;          /* exclusive */
+        std::vector<ImageProcessor::Result> result_list;    /* result_list[i] is the result of frame (frame_start + i) */
+        int32_t ret;
+        Chunk_() : frame_start(0), frame_range_start(0), frame_end(0), ret(kRetErr) {}
+    } Chunk;
+
+private:
+    static void ProcessChunk(const std::string& work_dir, const DetectionEngine::ModelConfig& model_config, const std::string& filename, double fps, int32_t num_threads, Chunk& chunk);
+    /* id_map: local track ID in the chunk -> global track ID. Only the matched tracks are added to id_map */
+    static void StitchTrack(const Chunk& chunk_prev, const std::map<int32_t, int32_t>& id_map_prev, const Chunk& chunk, std::map<int32_t, int32_t>& id_map);
+};
+
+#endif
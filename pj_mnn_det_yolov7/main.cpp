@@ -16,9 +16,22 @@ limitations under the License.
 /* for general */
 #include <cstdint>
 #include <cstdlib>
+#include <cstdio>
 #include <string>
+#include <vector>
+#include <map>
 #include <algorithm>
 #include <chrono>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -31,11 +44,341 @@ limitations under the License.
 #define WORK_DIR                      RESOURCE_DIR
 #define DEFAULT_INPUT_IMAGE           RESOURCE_DIR"/kite.jpg"
 #define LOOP_NUM_FOR_TIME_MEASUREMENT 10
+#define CAPTURE_BUFFER_NUM            4
+#define BATCH_PROGRESS_INTERVAL       1000
 
 /*** Function ***/
+static FILE* OpenResultOutput(const std::string& path, bool is_binary)
+{
+    if (path != "-") {
+        return fopen(path.c_str(), is_binary ? "wb" : "w");
+    }
+
+    /* Results are written to stdout. Logs (printf) are redirected to stderr so that they don't break the result stream */
+    fflush(stdout);
+#ifdef _WIN32
+    int32_t fd = _dup(_fileno(stdout));
+    _dup2(_fileno(stderr), _fileno(stdout));
+    if (is_binary) _setmode(fd, _O_BINARY);
+    return _fdopen(fd, is_binary ? "wb" : "w");
+#else
+    int32_t fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    return fdopen(fd, "w");
+#endif
+}
+
+static std::string EscapeJson(const std::string& str)
+{
+    std::string escaped;
+    for (const char c : str) {
+        switch (c) {
+        case '"':  escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\b': escaped += "\\b"; break;
+        case '\f': escaped += "\\f"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (static_cast<uint8_t>(c) < 0x20) {
+                /* Other control characters are not allowed in JSON string */
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", static_cast<uint8_t>(c));
+                escaped += code;
+            } else {
+                escaped += c;
+            }
+            break;
+        }
+    }
+    return escaped;
+}
+
+static void WriteLabelListJson(FILE* fp, const std::vector<std::string>& label_list)
+{
+    /* The first line is the label table */
+    fprintf(fp, "{\"labels\":[");
+    for (size_t i = 0; i < label_list.size(); i++) {
+        fprintf(fp, "%s\"%s\"", i == 0 ? "" : ",", EscapeJson(label_list[i]).c_str());
+    }
+    fprintf(fp, "]}\n");
+}
+
+static void WriteLabelListBinary(FILE* fp, const std::vector<std::string>& label_list, bool is_update = false)
+{
+    /* The label table in the middle of the records is marked by a header with frame = kRecordLabelTable */
+    if (is_update) {
+        const ImageProcessor::RecordHeader header = { ImageProcessor::kRecordLabelTable, 0, 0, 0, 0 };
+        fwrite(&header, sizeof(header), 1, fp);
+    }
+    /* The label table at the beginning: int32 num, then (int32 length, char[length]) * num */
+    const int32_t label_num = static_cast<int32_t>(label_list.size());
+    fwrite(&label_num, sizeof(label_num), 1, fp);
+    for (const auto& label : label_list) {
+        const int32_t length = static_cast<int32_t>(label.size());
+        fwrite(&length, sizeof(length), 1, fp);
+        fwrite(label.data(), 1, length, fp);
+    }
+}
+
+/* file: name of the image file in batch mode */
+static void WriteResultJson(FILE* fp, int32_t frame, const ImageProcessor::Result& result, const std::string& file = "")
+{
+    fprintf(fp, "{\"frame\":%d,", frame);
+    if (!file.empty()) {
+        fprintf(fp, "\"file\":\"%s\",", EscapeJson(file).c_str());
+    }
+    fprintf(fp, "\"time_pre_process\":%.3f,\"time_inference\":%.3f,\"time_post_process\":%.3f,\"objects\":[",
+        result.time_pre_process, result.time_inference, result.time_post_process);
+    for (size_t i = 0; i < result.object_list.size(); i++) {
+        const auto& object = result.object_list[i];
+        fprintf(fp, "%s{\"track_id\":%d,\"class_id\":%d,\"score\":%.3f,\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d}",
+            i == 0 ? "" : ",", object.track_id, object.class_id, object.score, object.x, object.y, object.width, object.height);
+    }
+    fprintf(fp, "]}\n");
+}
+
+static void WriteResultBinary(FILE* fp, int32_t frame, const ImageProcessor::Result& result)
+{
+    /* Object is POD, so the list is written as it is without conversion */
+    const int32_t object_num = static_cast<int32_t>(result.object_list.size());
+    ImageProcessor::RecordHeader header = { frame, object_num, result.time_pre_process, result.time_inference, result.time_post_process };
+    fwrite(&header, sizeof(header), 1, fp);
+    if (object_num > 0) fwrite(result.object_list.data(), sizeof(ImageProcessor::Object), object_num, fp);
+}
+
+/*** Batch mode for still images ***/
+static bool ListImageFile(const std::string& input_name, std::vector<std::string>& file_list)
+{
+    /* input_name is a directory, or a glob pattern of files such as "dir/img_*.jpg" */
+    std::vector<cv::String> path_list;
+    try {
+        cv::glob(input_name, path_list, false);
+    } catch (...) {
+        return false;
+    }
+    file_list.clear();
+    for (const auto& path : path_list) {
+        std::string ext = path.substr(path.find_last_of('.') + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp") {
+            file_list.push_back(path);
+        }
+    }
+    std::sort(file_list.begin(), file_list.end());
+    return !file_list.empty();
+}
+
+static bool GetJpegSize(const std::vector<uint8_t>& data, int32_t& width, int32_t& height)
+{
+    /* Read the size from SOF marker without decoding */
+    if (data.size() < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+    size_t pos = 2;
+    while (pos + 9 < data.size()) {
+        if (data[pos] != 0xFF) return false;
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {   /* fill byte */
+            pos++;
+            continue;
+        }
+        /* SOF0 - SOF15, except DHT(C4), JPG(C8) and DAC(CC) */
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            height = (data[pos + 5] << 8) | data[pos + 6];
+            width = (data[pos + 7] << 8) | data[pos + 8];
+            return true;
+        }
+        pos += 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+    }
+    return false;
+}
+
+/* Decode images on worker threads. Images are returned in the order of the file list */
+class BatchImageLoader {
+public:
+    /* min_size: JPEG is decoded at 1/2, 1/4 or 1/8 resolution as long as the image is larger than this. (0, 0) = always full resolution */
+    BatchImageLoader(const std::vector<std::string>& file_list, int32_t worker_num, const cv::Size& min_size)
+        : file_list_(file_list), min_size_(min_size), queue_size_(worker_num * 2), index_next_decode_(0), index_next_get_(0), is_stop_(false)
+    {
+        for (int32_t i = 0; i < worker_num; i++) {
+            thread_list_.push_back(std::thread(&BatchImageLoader::ThreadFunc, this));
+        }
+    }
+
+    ~BatchImageLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_stop_ = true;
+        }
+        cond_.notify_all();
+        for (auto& thread : thread_list_) thread.join();
+    }
+
+    /* Return false when all images are returned. mat is empty if the file is not decoded. scale = original size / decoded size */
+    bool Get(int32_t& index, cv::Mat& mat, int32_t& scale)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (index_next_get_ >= static_cast<int32_t>(file_list_.size())) return false;
+        cond_.wait(lock, [this] { return decoded_map_.count(index_next_get_) > 0; });
+        auto it = decoded_map_.find(index_next_get_);
+        index = it->first;
+        mat = it->second.first;
+        scale = it->second.second;
+        decoded_map_.erase(it);
+        index_next_get_++;
+        lock.unlock();
+        cond_.notify_all();
+        return true;
+    }
+
+private:
+    void ThreadFunc()
+    {
+        std::vector<uint8_t> data;
+        while (true) {
+            int32_t index = 0;
+            {
+                /* Don't decode too far ahead of the consumer */
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return is_stop_ || index_next_decode_ < index_next_get_ + queue_size_; });
+                if (is_stop_ || index_next_decode_ >= static_cast<int32_t>(file_list_.size())) break;
+                index = index_next_decode_++;
+            }
+
+            cv::Mat mat;
+            int32_t scale = 1;
+            std::ifstream ifs(file_list_[index], std::ios::binary);
+            if (ifs) {
+                data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+                int32_t flag = cv::IMREAD_COLOR;
+                int32_t width = 0;
+                int32_t height = 0;
+                if (min_size_.width > 0 && GetJpegSize(data, width, height)) {
+                    if (width / 8 >= min_size_.width && height / 8 >= min_size_.height) {
+                        flag = cv::IMREAD_REDUCED_COLOR_8;
+                        scale = 8;
+                    } else if (width / 4 >= min_size_.width && height / 4 >= min_size_.height) {
+                        flag = cv::IMREAD_REDUCED_COLOR_4;
+                        scale = 4;
+                    } else if (width / 2 >= min_size_.width && height / 2 >= min_size_.height) {
+                        flag = cv::IMREAD_REDUCED_COLOR_2;
+                        scale = 2;
+                    }
+                }
+                mat = cv::imdecode(data, flag);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                decoded_map_[index] = std::make_pair(mat, scale);
+            }
+            cond_.notify_all();
+        }
+    }
+
+private:
+    const std::vector<std::string>& file_list_;
+    cv::Size min_size_;
+    int32_t queue_size_;
+    int32_t index_next_decode_;
+    int32_t index_next_get_;
+    bool is_stop_;
+    std::map<int32_t, std::pair<cv::Mat, int32_t>> decoded_map_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<std::thread> thread_list_;
+};
+
+static void RunBatch(const std::vector<std::string>& file_list, int32_t worker_num, bool is_reduced_decode, FILE* fp_result, bool is_binary)
+{
+    cv::Size min_size(0, 0);
+    if (is_reduced_decode) {
+        ImageProcessor::GetInputSize(min_size.width, min_size.height);
+    }
+
+    const auto& time_start = std::chrono::steady_clock::now();
+    double total_time_inference = 0;
+    int32_t image_num = 0;
+    BatchImageLoader loader(file_list, worker_num, min_size);
+    ImageProcessor::Result result;  /* reused across images */
+    int32_t index;
+    cv::Mat image;
+    int32_t scale;
+    while (loader.Get(index, image, scale)) {
+        result.object_list.clear();
+        result.time_pre_process = result.time_inference = result.time_post_process = 0;
+        if (image.empty()) {
+            printf("Failed to read %s\n", file_list[index].c_str());
+        } else if (ImageProcessor::Detect(image, result) == 0) {
+            /* Coordinates in the original image */
+            for (auto& object : result.object_list) {
+                object.x *= scale;
+                object.y *= scale;
+                object.width *= scale;
+                object.height *= scale;
+            }
+        }
+        if (is_binary) {
+            WriteResultBinary(fp_result, index, result);
+        } else {
+            WriteResultJson(fp_result, index, result, file_list[index]);
+        }
+        total_time_inference += result.time_inference;
+        image_num++;
+        if (image_num % BATCH_PROGRESS_INTERVAL == 0) {
+            const double time_elapsed = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - time_start).count();
+            printf("%d / %d images, %.1f [images/sec]\n", image_num, static_cast<int32_t>(file_list.size()), image_num / time_elapsed);
+        }
+    }
+    const double time_elapsed = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - time_start).count();
+    printf("=== Batch ===\n");
+    printf("Images:              %9d\n", image_num);
+    printf("Total:               %9.3lf [sec]\n", time_elapsed);
+    printf("Throughput:          %9.1lf [images/sec]\n", image_num / time_elapsed);
+    if (image_num > 0) {
+        printf("  Inference:         %9.3lf [msec/image]\n", total_time_inference / image_num);
+    }
+}
+
+/*** Chunk mode for video file ***/
+static int32_t RunChunk(const ImageProcessor::InputParam& input_param, const std::string& input_name, int32_t chunk_num, FILE* fp_result, bool is_binary)
+{
+    std::vector<std::string> label_list;
+    if (ImageProcessor::GetDefaultLabelList(input_param, label_list) != 0) {
+        printf("Failed to read the label table\n");
+        return -1;
+    }
+    if (is_binary) {
+        WriteLabelListBinary(fp_result, label_list);
+    } else {
+        WriteLabelListJson(fp_result, label_list);
+    }
+
+    /* Results are written as soon as each chunk is stitched */
+    const auto& time_start = std::chrono::steady_clock::now();
+    int32_t frame_num = 0;
+    const int32_t ret = ImageProcessor::ProcessVideo(input_param, input_name, chunk_num, [fp_result, is_binary, &frame_num](int32_t frame, const ImageProcessor::Result& result) {
+        if (is_binary) {
+            WriteResultBinary(fp_result, frame, result);
+        } else {
+            WriteResultJson(fp_result, frame, result);
+        }
+        frame_num++;
+    });
+    if (ret != 0) {
+        printf("Failed to process %s\n", input_name.c_str());
+        return -1;
+    }
+    const double time_elapsed = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - time_start).count();
+    printf("%d frames, %.1f [frames/sec]\n", frame_num, frame_num / time_elapsed);
+    return 0;
+}
+
 int32_t main(int argc, char* argv[])
 {
     /*** Initialize ***/
+    const auto& time_startup0 = std::chrono::steady_clock::now();
     /* variables for processing time measurement */
     double total_time_all = 0;
     double total_time_cap = 0;
@@ -44,68 +387,225 @@ int32_t main(int argc, char* argv[])
     double total_time_inference = 0;
     double total_time_post_process = 0;
 
+    /* Parse arguments */
+    /*   --headless: no drawing and no display. Results are written as structured data */
+    /*   --format=jsonl|binary: format of the results in headless mode (default: jsonl). The label table comes first, then a record for each frame. The label table is written again when it's changed by model reload */
+    /*   --output=path: output file of the results in headless mode. "-" = stdout (default) */
+    /*   --render-interval=n: draw and display the result every n frames (default: 1) */
+    /*   --decode-threads=n: number of threads to decode video file, if the backend allows. 0 = backend default (default) */
+    /*   --batch: input is a directory or a glob pattern of images. Detect each image independently and write the results (as headless) */
+    /*   --workers=n: number of threads to decode images in batch mode (default: number of cores) */
+    /*   --reduced-decode: decode JPEG at reduced resolution, not smaller than the model input, in batch mode */
+    /*   --chunks=n: split the video file into n time chunks and process them in parallel (as headless). Track IDs are stitched across chunks */
+    std::string input_name = DEFAULT_INPUT_IMAGE;
+    bool is_headless = false;
+    bool is_binary = false;
+    std::string output_path = "-";
+    int32_t render_interval = 1;
+    int32_t decode_thread_num = 0;
+    bool is_batch = false;
+    int32_t worker_num = (std::max)(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+    bool is_reduced_decode = false;
+    int32_t chunk_num = 0;
+    for (int32_t i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--headless") {
+            is_headless = true;
+        } else if (arg.find("--format=") == 0) {
+            const std::string format = arg.substr(9);
+            if (format != "jsonl" && format != "binary") {
+                printf("Unknown format: %s\n", format.c_str());
+                return -1;
+            }
+            is_binary = format == "binary";
+        } else if (arg.find("--output=") == 0) {
+            output_path = arg.substr(9);
+        } else if (arg.find("--render-interval=") == 0) {
+            render_interval = (std::max)(1, std::atoi(arg.substr(18).c_str()));
+        } else if (arg.find("--decode-threads=") == 0) {
+            decode_thread_num = (std::max)(0, std::atoi(arg.substr(17).c_str()));
+        } else if (arg == "--batch") {
+            is_batch = true;
+        } else if (arg.find("--workers=") == 0) {
+            worker_num = (std::max)(1, std::atoi(arg.substr(10).c_str()));
+        } else if (arg == "--reduced-decode") {
+            is_reduced_decode = true;
+        } else if (arg.find("--chunks=") == 0) {
+            chunk_num = (std::max)(0, std::atoi(arg.substr(9).c_str()));
+        } else {
+            input_name = arg;
+        }
+    }
+
+    std::vector<std::string> file_list;
+    if (is_batch) {
+        if (!ListImageFile(input_name, file_list)) {
+            printf("No image is found: %s\n", input_name.c_str());
+            return -1;
+        }
+        is_headless = true;
+    }
+    if (chunk_num > 0) {
+        is_headless = true;
+    }
+
+    FILE* fp_result = nullptr;
+    if (is_headless) {
+        fp_result = OpenResultOutput(output_path, is_binary);
+        if (!fp_result) {
+            printf("Failed to open %s\n", output_path.c_str());
+            return -1;
+        }
+    }
+
     /* Find source image */
-    std::string input_name = (argc > 1) ? argv[1] : DEFAULT_INPUT_IMAGE;
     cv::VideoCapture cap;   /* if cap is not opened, src is still image */
-    if (!CommonHelper::FindSourceImage(input_name, cap)) {
+    if (!is_batch && !CommonHelper::FindSourceImage(input_name, cap, 640, 480, decode_thread_num)) {
         return -1;
     }
 
+    ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
+    if (chunk_num > 0) {
+        /* Each chunk opens the file and creates the engine by itself, so ImageProcessor is not initialized */
+        if (cap.get(cv::CAP_PROP_FRAME_COUNT) <= 0) {
+            printf("--chunks is for video file\n");
+            return -1;
+        }
+        cap.release();
+        const int32_t ret = RunChunk(input_param, input_name, chunk_num, fp_result, is_binary);
+        fclose(fp_result);
+        return ret;
+    }
+
     /* Create video writer to save output video */
     cv::VideoWriter writer;
     // writer = cv::VideoWriter("out.mp4", cv::VideoWriter::fourcc('M', 'P', '4', 'V'), (std::max)(10.0, cap.get(cv::CAP_PROP_FPS)), cv::Size(static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_HEIGHT))));
 
+    /* Decode on another thread. Every frame in order for video file, the newest frame for camera */
+    CommonHelper::VideoCaptureAsync cap_async;
+    bool is_file = false;
+    double fps = 0;
+    if (cap.isOpened()) {
+        is_file = cap.get(cv::CAP_PROP_FRAME_COUNT) > 0;
+        fps = cap.get(cv::CAP_PROP_FPS);
+        cap_async.Open(cap, is_file ? CommonHelper::VideoCaptureAsync::kPolicyEveryFrame : CommonHelper::VideoCaptureAsync::kPolicyLatest, CAPTURE_BUFFER_NUM);
+    }
+
     /* Initialize image processor library */
-    ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
+    const auto& time_initialize0 = std::chrono::steady_clock::now();
     if (ImageProcessor::Initialize(input_param) != 0) {
         printf("Initialization Error\n");
         return -1;
     }
 
+    const auto& time_initialize1 = std::chrono::steady_clock::now();
+
+    ImageProcessor::Warmup();
+
+    /* Tracker works in the unit of the frame interval of the source */
+    if (fps > 0) {
+        ImageProcessor::SetFrameRate(fps);
+    }
+
+    if (fp_result) {
+        std::vector<std::string> label_list;
+        ImageProcessor::GetLabelList(label_list);
+        if (is_binary) {
+            WriteLabelListBinary(fp_result, label_list);
+        } else {
+            WriteLabelListJson(fp_result, label_list);
+        }
+    }
+
+    if (is_batch) {
+        RunBatch(file_list, worker_num, is_reduced_decode, fp_result, is_binary);
+        ImageProcessor::Finalize();
+        fclose(fp_result);
+        return 0;
+    }
+
+    /* Still image is decoded only once */
+    cv::Mat image_still;
+    if (!cap_async.IsOpened()) {
+        image_still = cv::imread(input_name);
+    }
+
     /*** Process for each frame ***/
+    /* Still image is processed repeatedly for time measurement, except in headless mode where each record is a result */
+    const int32_t loop_num_still = is_headless ? 1 : LOOP_NUM_FOR_TIME_MEASUREMENT;
+    ImageProcessor::Result result;  /* reused across frames */
     int32_t frame_cnt = 0;
-    for (frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
+    cv::Mat image;  /* reused across frames. The buffer is given back to the capture */
+    for (frame_cnt = 0; cap_async.IsOpened() || frame_cnt < loop_num_still; frame_cnt++) {
         const auto& time_all0 = std::chrono::steady_clock::now();
         /* Read image */
         const auto& time_cap0 = std::chrono::steady_clock::now();
-        cv::Mat image;
-        if (cap.isOpened()) {
-            cap.read(image);
+        double timestamp = -1.0;
+        if (cap_async.IsOpened()) {
+            if (!cap_async.Read(image, timestamp)) image.release();
         } else {
-            image = cv::imread(input_name);
+            image_still.copyTo(image);  /* copy because the image is drawn */
         }
         if (image.empty()) break;
         const auto& time_cap1 = std::chrono::steady_clock::now();
 
         /* Call image processor library */
         const auto& time_image_process0 = std::chrono::steady_clock::now();
-        ImageProcessor::Result result;
-        ImageProcessor::Process(image, result);
+        ImageProcessor::Analyze(image, result, timestamp);
         const auto& time_image_process1 = std::chrono::steady_clock::now();
 
-        /* Display result */
-        if (writer.isOpened()) writer.write(image);
-        cv::imshow("test", image);
+        if (is_headless) {
+            /* Output structured result only */
+            /* The label table is written again before the first record with the new class_id */
+            if (result.is_label_list_changed) {
+                std::vector<std::string> label_list;
+                ImageProcessor::GetLabelList(label_list);
+                if (is_binary) {
+                    WriteLabelListBinary(fp_result, label_list, true);
+                } else {
+                    WriteLabelListJson(fp_result, label_list);
+                }
+            }
+            if (is_binary) {
+                WriteResultBinary(fp_result, frame_cnt, result);
+            } else {
+                WriteResultJson(fp_result, frame_cnt, result);
+            }
+        } else if (frame_cnt % render_interval == 0) {
+            /* Display result */
+            ImageProcessor::Draw(image);
+            if (writer.isOpened()) writer.write(image);
+            cv::imshow("test", image);
 
-        /* Input key command */
-        if (cap.isOpened()) {
-            /* this code needs to be before calculating processing time because cv::waitKey includes image output */
-            /* however, when 'q' key is pressed (cap.released()), processing time significantly incraeases. So escape from the loop before calculating time */
-            if (CommonHelper::InputKeyCommand(cap)) break;
-        };
+            /* Input key command */
+            if (cap_async.IsOpened()) {
+                /* this code needs to be before calculating processing time because cv::waitKey includes image output */
+                /* however, when 'q' key is pressed (cap.released()), processing time significantly incraeases. So escape from the loop before calculating time */
+                if (CommonHelper::InputKeyCommand(cap_async)) break;
+            };
+        }
 
         /* Print processing time */
         const auto& time_all1 = std::chrono::steady_clock::now();
         double time_all = (time_all1 - time_all0).count() / 1000000.0;
         double time_cap = (time_cap1 - time_cap0).count() / 1000000.0;
         double time_image_process = (time_image_process1 - time_image_process0).count() / 1000000.0;
-        printf("Total:               %9.3lf [msec]\n", time_all);
-        printf("  Capture:           %9.3lf [msec]\n", time_cap);
-        printf("  Image processing:  %9.3lf [msec]\n", time_image_process);
-        printf("    Pre processing:  %9.3lf [msec]\n", result.time_pre_process);
-        printf("    Inference:       %9.3lf [msec]\n", result.time_inference);
-        printf("    Post processing: %9.3lf [msec]\n", result.time_post_process);
-        printf("=== Finished %d frame ===\n\n", frame_cnt);
+        if (!is_headless) {
+            printf("Total:               %9.3lf [msec]\n", time_all);
+            printf("  Capture:           %9.3lf [msec]\n", time_cap);
+            printf("  Image processing:  %9.3lf [msec]\n", time_image_process);
+            printf("    Pre processing:  %9.3lf [msec]\n", result.time_pre_process);
+            printf("    Inference:       %9.3lf [msec]\n", result.time_inference);
+            printf("    Post processing: %9.3lf [msec]\n", result.time_post_process);
+            if (frame_cnt == 0) {
+                double time_first_result = (time_image_process1 - time_startup0).count() / 1000000.0;
+                double time_initialize = (time_initialize1 - time_initialize0).count() / 1000000.0;
+                printf("Time to first result:%9.3lf [msec]\n", time_first_result);
+                printf("  Initialize:        %9.3lf [msec]\n", time_initialize);
+                printf("  First process:     %9.3lf [msec]\n", time_image_process);
+            }
+            printf("=== Finished %d frame ===\n\n", frame_cnt);
+        }
 
         if (frame_cnt > 0) {    /* do not count the first process because it may include initialize process */
             total_time_all += time_all;
@@ -133,7 +633,11 @@ int32_t main(int argc, char* argv[])
     /* Fianlize image processor library */
     ImageProcessor::Finalize();
     if (writer.isOpened()) writer.release();
-    cv::waitKey(-1);
+    if (fp_result) {
+        fclose(fp_result);
+    } else {
+        cv::waitKey(-1);
+    }
 
     return 0;
 }
@@ -42,8 +42,11 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+#define MODEL_CONFIG_NAME "model_config_lane.txt"   /* in the model directory. Optional */
+
 /*** Global variable ***/
 std::unique_ptr<LaneEngine> s_engine;
+std::string s_work_dir;
 CommonHelper::NiceColorGenerator s_nice_color_generator(4);
 
 /*** Function ***/
@@ -58,6 +61,20 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
     CommonHelper::DrawText(mat, text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 }
 
+/* The default model config is overwritten by the config file if it exists, so that another model can be used without rebuild */
+static int32_t CreateModelConfig(const std::string& work_dir, LaneEngine::ModelConfig& model_config)
+{
+    model_config = LaneEngine::CreateDefaultModelConfig();
+    const std::string filename = work_dir + "/model/" + MODEL_CONFIG_NAME;
+    std::ifstream ifs(filename);
+    if (ifs.fail()) return 0;
+    if (LaneEngine::ReadModelConfig(filename, model_config) != LaneEngine::kRetOk) {
+        return -1;
+    }
+    PRINT("Model config: %s\n", filename.c_str());
+    return 0;
+}
+
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
     if (s_engine) {
@@ -65,8 +82,13 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
+    s_work_dir = input_param.work_dir;
+    LaneEngine::ModelConfig model_config;
+    if (CreateModelConfig(s_work_dir, model_config) != 0) {
+        return -1;
+    }
     s_engine.reset(new LaneEngine());
-    if (s_engine->Initialize(input_param.work_dir, input_param.num_threads) != LaneEngine::kRetOk) {
+    if (s_engine->Initialize(input_param.work_dir, input_param.num_threads, model_config) != LaneEngine::kRetOk) {
         s_engine->Finalize();
         s_engine.reset();
         return -1;
@@ -74,6 +96,19 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
     return 0;
 }
 
+int32_t ImageProcessor::Warmup(int32_t iterations)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+
+    if (s_engine->Warmup(iterations) != LaneEngine::kRetOk) {
+        return -1;
+    }
+    return 0;
+}
+
 int32_t ImageProcessor::Finalize(void)
 {
     if (!s_engine) {
@@ -98,6 +133,15 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
     switch (cmd) {
     case 0:
+        /* Reload the model with the config file (MODEL_CONFIG_NAME) read again. Processing continues with the current model until the new one is ready */
+        {
+            LaneEngine::ModelConfig model_config;
+            if (CreateModelConfig(s_work_dir, model_config) != 0 || s_engine->Reload(model_config) != LaneEngine::kRetOk) {
+                return -1;
+            }
+        }
+        PRINT("Reloading model\n");
+        return 0;
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
         return -1;
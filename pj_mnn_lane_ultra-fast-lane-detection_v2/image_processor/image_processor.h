@@ -44,6 +44,8 @@ int32_t Initialize(const InputParam& input_param);
 int32_t Process(cv::Mat& mat, Result& result);
 int32_t Finalize(void);
 int32_t Command(int32_t cmd);
+/* Run the engines with synthetic images (CommonHelper::RunWarmup). Call after Initialize */
+int32_t Warmup(int32_t iterations = 2);
 
 }
 
@@ -24,6 +24,11 @@ limitations under the License.
 #include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <sstream>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -40,19 +45,26 @@ limitations under the License.
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
 /* Model parameters */
+/* Default model config. Another config can be given at Initialize and Reload */
 #define USE_CULANE
 //#define USE_TUSIMPLE
 //#define USE_CULANECURVELANES
 
 #if defined(USE_CULANE)
-#define MODEL_NAME  "ufldv2_culane_res18_320x1600.mnn"
-#define INPUT_DIMS  { 1, 3, 320, 1600 }
+#define MODEL_NAME   "ufldv2_culane_res18_320x1600.mnn"
+#define INPUT_HEIGHT 320
+#define INPUT_WIDTH  1600
+#define DATASET      LaneEngine::kDatasetCulane
 #elif defined(USE_TUSIMPLE)
-#define MODEL_NAME  "ufldv2_tusimple_res18_320x800.mnn"
-#define INPUT_DIMS  { 1, 3, 320, 800 }
+#define MODEL_NAME   "ufldv2_tusimple_res18_320x800.mnn"
+#define INPUT_HEIGHT 320
+#define INPUT_WIDTH  800
+#define DATASET      LaneEngine::kDatasetTusimple
 #elif defined(USE_CULANECURVELANES)
-#define MODEL_NAME  "ufldv2_curvelanes_res18_800x1600.mnn"
-#define INPUT_DIMS  { 1, 3, 800, 1600 }
+#define MODEL_NAME   "ufldv2_curvelanes_res18_800x1600.mnn"
+#define INPUT_HEIGHT 800
+#define INPUT_WIDTH  1600
+#define DATASET      LaneEngine::kDatasetCurvelanes
 #endif
 
 #define TENSORTYPE  TensorInfo::kTensorTypeFp32
@@ -64,47 +76,188 @@ limitations under the License.
 #define OUTPUT_NAME_2 "exist_row"
 #define OUTPUT_NAME_3 "exist_col"
 
-#if defined(USE_CULANE)
-static constexpr int32_t kNumRow = 72;
-static constexpr int32_t kNumCol = 81;
-static constexpr float kCropRatio = 0.6;
-#elif defined(USE_TUSIMPLE)
-static constexpr int32_t kNumRow = 56;
-static constexpr int32_t kNumCol = 41;
-static constexpr float kCropRatio = 0.8;
-#elif defined(USE_CULANECURVELANES)
-static constexpr int32_t kNumRow = 72;
-static constexpr int32_t kNumCol = 81;
-static constexpr float kCropRatio = 0.8;
-#endif
-
-void LaneEngine::GenerateAnchor()
+/* Parameters for each dataset (index = kDatasetXXX) */
+static const struct {
+    int32_t num_row;
+    int32_t num_col;
+    float   crop_ratio;
+    float   row_anchor_start;
+    float   row_anchor_end;
+    float   crop_y;             /* ratio to the image height */
+    float   crop_h;
+    bool    has_extra_output;   /* "282", "288" */
+} kDatasetParamList[] = {
+    { 72, 81, 0.6f, 0.42f,          1.0f,          0.4f, 0.5f, false },   /* CULane */
+    { 56, 41, 0.8f, 160.0f / 720,   710.0f / 720,  0.0f, 1.0f, false },   /* TuSimple */
+    { 72, 81, 0.8f, 0.4f,           1.0f,          0.0f, 1.0f, true  },   /* CurveLanes */
+};
+
+void LaneEngine::GenerateAnchor(int32_t dataset, std::vector<float>& row_anchor, std::vector<float>& col_anchor)
 {
-    for (int32_t i = 0; i < kNumRow; i++) {
-#if defined(USE_CULANE)
-        row_anchor_.push_back(0.42 + i * (1.0 - 0.42) / (kNumRow - 1));
-#elif defined(USE_TUSIMPLE)
-        row_anchor_.push_back((160 + i * (710 - 160) / (kNumRow - 1)) / 720.0);
-#elif defined(USE_CULANECURVELANES)
-        row_anchor_.push_back(0.4 + i * (1.0 - 0.4) / (kNumRow - 1));
-#endif
+    const auto& param = kDatasetParamList[dataset];
+    row_anchor.clear();
+    for (int32_t i = 0; i < param.num_row; i++) {
+        row_anchor.push_back(param.row_anchor_start + i * (param.row_anchor_end - param.row_anchor_start) / (param.num_row - 1));
     }
 
-    for (int32_t i = 0; i < kNumCol; i++) {
-        col_anchor_.push_back(0.0 + i * (1.0 - 0.0) / (kNumCol - 1));
+    col_anchor.clear();
+    for (int32_t i = 0; i < param.num_col; i++) {
+        col_anchor.push_back(0.0 + i * (1.0 - 0.0) / (param.num_col - 1));
     }
 }
 
 /*** Function ***/
-int32_t LaneEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
+LaneEngine::ModelConfig LaneEngine::CreateDefaultModelConfig(void)
+{
+    ModelConfig model_config;
+    model_config.model_name = MODEL_NAME;
+    model_config.height = INPUT_HEIGHT;
+    model_config.width = INPUT_WIDTH;
+    model_config.dataset = DATASET;
+    model_config.input_name = INPUT_NAME;
+    model_config.output_name_list = { OUTPUT_NAME_0, OUTPUT_NAME_1, OUTPUT_NAME_2, OUTPUT_NAME_3 };
+    if (kDatasetParamList[DATASET].has_extra_output) {
+        model_config.output_name_list.push_back("282");
+        model_config.output_name_list.push_back("288");
+    }
+    return model_config;
+}
+
+int32_t LaneEngine::ReadModelConfig(const std::string& filename, ModelConfig& model_config)
 {
+    std::map<std::string, std::string> key_value_map;
+    if (!CommonHelper::ReadKeyValueFile(filename, key_value_map)) {
+        PRINT_E("Failed to read %s\n", filename.c_str());
+        return kRetErr;
+    }
+
+    for (const auto& key_value : key_value_map) {
+        const std::string& key = key_value.first;
+        const std::string& value = key_value.second;
+        if (key == "model_name") {
+            model_config.model_name = value;
+        } else if (key == "height") {
+            model_config.height = std::atoi(value.c_str());
+        } else if (key == "width") {
+            model_config.width = std::atoi(value.c_str());
+        } else if (key == "dataset") {
+            model_config.dataset = std::atoi(value.c_str());
+        } else if (key == "input_name") {
+            model_config.input_name = value;
+        } else if (key == "output_name_list") {
+            std::istringstream iss(value);
+            std::string name;
+            model_config.output_name_list.clear();
+            while (iss >> name) model_config.output_name_list.push_back(name);
+        } else {
+            PRINT("Unknown key in %s: %s. Ignored\n", filename.c_str(), key.c_str());
+        }
+    }
+
+    /* The number of outputs is checked at session creation */
+    const int32_t dataset_num = static_cast<int32_t>(sizeof(kDatasetParamList) / sizeof(kDatasetParamList[0]));
+    if (model_config.height <= 0 || model_config.width <= 0 || model_config.dataset < 0 || model_config.dataset >= dataset_num) {
+        PRINT_E("Invalid model config in %s\n", filename.c_str());
+        return kRetErr;
+    }
+    return kRetOk;
+}
+
+int32_t LaneEngine::Initialize(const std::string& work_dir, const int32_t num_threads, const ModelConfig& model_config)
+{
+    work_dir_ = work_dir;
+    num_threads_ = num_threads;
+
+    std::shared_ptr<Session> session;
+    if (CreateSession(model_config, session) != kRetOk) {
+        return kRetErr;
+    }
+    session_ = session;
+
+    return kRetOk;
+}
+
+int32_t LaneEngine::Finalize()
+{
+    if (reload_thread_.joinable()) reload_thread_.join();
+    session_reloaded_.reset();
+    if (!session_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    session_.reset();
+    return kRetOk;
+}
+
+int32_t LaneEngine::Warmup(int32_t iterations)
+{
+    if (!session_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    const InputTensorInfo& input_tensor_info = session_->input_tensor_info_list[0];
+    const bool is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), iterations, [this](const cv::Mat& mat) {
+        Result result;
+        return Process(mat, result) == kRetOk;
+    });
+    return is_ok ? kRetOk : kRetErr;
+}
+
+int32_t LaneEngine::Reload(const ModelConfig& model_config)
+{
+    if (is_reloading_) {
+        PRINT_E("Reload is in progress\n");
+        return kRetErr;
+    }
+    if (reload_thread_.joinable()) reload_thread_.join();
+
+    /* Create the new session on a background thread not to stop Process. It is swapped in by SwapSession at the next frame */
+    is_reloading_ = true;
+    reload_thread_ = std::thread([this, model_config]() {
+        std::shared_ptr<Session> session;
+        if (CreateSession(model_config, session) == kRetOk) {
+            std::lock_guard<std::mutex> lock(reload_mutex_);
+            session_reloaded_ = session;
+        } else {
+            PRINT_E("Failed to reload. The current model is kept\n");
+        }
+        is_reloading_ = false;
+    });
+    return kRetOk;
+}
+
+void LaneEngine::SwapSession(void)
+{
+    std::shared_ptr<Session> session_old;   /* released after unlock */
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    if (!session_reloaded_) return;
+    session_old = session_;
+    session_ = session_reloaded_;
+    session_reloaded_.reset();
+    PRINT("Model is reloaded: %s\n", session_->model_config.model_name.c_str());
+}
+
+int32_t LaneEngine::CreateSession(const ModelConfig& model_config, std::shared_ptr<Session>& session)
+{
+    if (model_config.dataset < 0 || model_config.dataset >= static_cast<int32_t>(sizeof(kDatasetParamList) / sizeof(kDatasetParamList[0]))) {
+        PRINT_E("Invalid dataset (%d)\n", model_config.dataset);
+        return kRetErr;
+    }
+    const size_t output_num = kDatasetParamList[model_config.dataset].has_extra_output ? 6 : 4;
+    if (model_config.input_name.empty() || model_config.output_name_list.size() != output_num) {
+        PRINT_E("Invalid tensor names. %d outputs are needed for the dataset (%d)\n", static_cast<int32_t>(output_num), model_config.dataset);
+        return kRetErr;
+    }
+    session.reset(new Session());
+    session->model_config = model_config;
+
     /* Set model information */
-    std::string model_filename = work_dir + "/model/" + MODEL_NAME;
+    std::string model_filename = work_dir_ + "/model/" + model_config.model_name;
 
     /* Set input tensor info */
-    input_tensor_info_list_.clear();
-    InputTensorInfo input_tensor_info(INPUT_NAME, TENSORTYPE, IS_NCHW);
-    input_tensor_info.tensor_dims = INPUT_DIMS;
+    session->input_tensor_info_list.clear();
+    InputTensorInfo input_tensor_info(model_config.input_name, TENSORTYPE, IS_NCHW);
+    input_tensor_info.tensor_dims = { 1, 3, model_config.height, model_config.width };
     input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
     /* normalize for imagenet */
     input_tensor_info.normalize.mean[0] = 0.485f;
@@ -113,51 +266,36 @@ int32_t LaneEngine::Initialize(const std::string& work_dir, const int32_t num_th
     input_tensor_info.normalize.norm[0] = 0.229f;
     input_tensor_info.normalize.norm[1] = 0.224f;
     input_tensor_info.normalize.norm[2] = 0.225f;
-    input_tensor_info_list_.push_back(input_tensor_info);
+    session->input_tensor_info_list.push_back(input_tensor_info);
 
     /* Set output tensor info */
-    output_tensor_info_list_.clear();
-    output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME_0, TENSORTYPE));
-    output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME_1, TENSORTYPE));
-    output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME_2, TENSORTYPE));
-    output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME_3, TENSORTYPE));
-    
-#if defined(USE_CULANECURVELANES)
-    output_tensor_info_list_.push_back(OutputTensorInfo("282", TENSORTYPE));
-    output_tensor_info_list_.push_back(OutputTensorInfo("288", TENSORTYPE));
-#endif
+    session->output_tensor_info_list.clear();
+    for (const auto& output_name : model_config.output_name_list) {
+        session->output_tensor_info_list.push_back(OutputTensorInfo(output_name, TENSORTYPE));
+    }
 
     /* Create and Initialize Inference Helper */
-    inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kMnn));
+    session->inference_helper.reset(InferenceHelper::Create(InferenceHelper::kMnn));
 
-    if (!inference_helper_) {
+    if (!session->inference_helper) {
         return kRetErr;
     }
 
-    if (inference_helper_->SetNumThreads(num_threads) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
+    if (session->inference_helper->SetNumThreads(num_threads_) != InferenceHelper::kRetOk) {
+        session->inference_helper.reset();
         return kRetErr;
     }
-    if (inference_helper_->Initialize(model_filename, input_tensor_info_list_, output_tensor_info_list_) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
+    if (session->inference_helper->Initialize(model_filename, session->input_tensor_info_list, session->output_tensor_info_list) != InferenceHelper::kRetOk) {
+        PRINT_E("Failed to create session for %s. Check the tensor names in ModelConfig\n", model_config.model_name.c_str());
+        session->inference_helper.reset();
         return kRetErr;
     }
 
-    GenerateAnchor();
+    GenerateAnchor(model_config.dataset, session->row_anchor, session->col_anchor);
 
     return kRetOk;
 }
 
-int32_t LaneEngine::Finalize()
-{
-    if (!inference_helper_) {
-        PRINT_E("Inference helper is not created\n");
-        return kRetErr;
-    }
-    inference_helper_->Finalize();
-    return kRetOk;
-}
-
 static std::vector<int32_t> argmax_1(const std::vector<float>& v, const std::vector<int32_t>& dims)
 {
     std::vector<int32_t> ret;
@@ -191,7 +329,8 @@ static int32_t sum_valid(const std::vector<int32_t>& v, int32_t num, int32_t int
 }
 
 
-std::vector<LaneEngine::Line<float>> LaneEngine::Pred2Coords(const std::vector<float>& loc_row, const std::vector<int32_t>& loc_row_dims, const std::vector<float>& exist_row, const std::vector<int32_t>& exist_row_dims,
+std::vector<LaneEngine::Line<float>> LaneEngine::Pred2Coords(const std::vector<float>& row_anchor, const std::vector<float>& col_anchor,
+                             const std::vector<float>& loc_row, const std::vector<int32_t>& loc_row_dims, const std::vector<float>& exist_row, const std::vector<int32_t>& exist_row_dims,
                              const std::vector<float>& loc_col, const std::vector<int32_t>& loc_col_dims, const std::vector<float>& exist_col, const std::vector<int32_t>& exist_col_dims)
 {
     std::vector<Line<float>> line_list(4);
@@ -227,7 +366,7 @@ std::vector<LaneEngine::Line<float>> LaneEngine::Pred2Coords(const std::vector<f
                         out_temp += pred_all_list_softmax[l] * all_ind_list[l];
                     }
                     float x = (out_temp + 0.5) / (num_grid_row - 1.0);
-                    float y = row_anchor_[k];
+                    float y = row_anchor[k];
                     line_list[i].push_back(std::pair<float, float>(x, y));
                 }
             }
@@ -252,7 +391,7 @@ std::vector<LaneEngine::Line<float>> LaneEngine::Pred2Coords(const std::vector<f
                         out_temp += pred_all_list_softmax[l] * all_ind_list[l];
                     }
                     float y = (out_temp + 0.5) / (num_grid_col - 1.0);
-                    float x = col_anchor_[k];
+                    float x = col_anchor[k];
                     line_list[i].push_back(std::pair<float, float>(x, y));
                 }
             }
@@ -266,25 +405,22 @@ std::vector<LaneEngine::Line<float>> LaneEngine::Pred2Coords(const std::vector<f
 
 int32_t LaneEngine::Process(const cv::Mat& original_mat, Result& result)
 {
-    if (!inference_helper_) {
+    /* Swap in the reloaded model between frames. The frame in process keeps using the session it started with */
+    SwapSession();
+    std::shared_ptr<Session> session = session_;
+    if (!session) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
     }
+    const auto& param = kDatasetParamList[session->model_config.dataset];
     /*** PreProcess ***/
     const auto& t_pre_process0 = std::chrono::steady_clock::now();
-    InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    InputTensorInfo& input_tensor_info = session->input_tensor_info_list[0];
     /* do crop, resize and color conversion here because some inference engine doesn't support these operations */
-#if defined(USE_CULANE)
-    int32_t crop_x = 0;
-    int32_t crop_y = original_mat.rows * 0.4;
-    int32_t crop_w = original_mat.cols;
-    int32_t crop_h = original_mat.rows * 0.5;
-#else
     int32_t crop_x = 0;
-    int32_t crop_y = original_mat.rows * 0.0;
+    int32_t crop_y = static_cast<int32_t>(original_mat.rows * param.crop_y);
     int32_t crop_w = original_mat.cols;
-    int32_t crop_h = original_mat.rows * 1.0;
-#endif
+    int32_t crop_h = static_cast<int32_t>(original_mat.rows * param.crop_h);
     cv::Mat img_src = cv::Mat::zeros(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
     CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
     //CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeCut);
@@ -301,35 +437,35 @@ int32_t LaneEngine::Process(const cv::Mat& original_mat, Result& result)
     input_tensor_info.image_info.crop_height = img_src.rows;
     input_tensor_info.image_info.is_bgr = false;
     input_tensor_info.image_info.swap_color = false;
-    if (inference_helper_->PreProcess(input_tensor_info_list_) != InferenceHelper::kRetOk) {
+    if (session->inference_helper->PreProcess(session->input_tensor_info_list) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
     const auto& t_pre_process1 = std::chrono::steady_clock::now();
 
     /*** Inference ***/
     const auto& t_inference0 = std::chrono::steady_clock::now();
-    if (inference_helper_->Process(output_tensor_info_list_) != InferenceHelper::kRetOk) {
+    if (session->inference_helper->Process(session->output_tensor_info_list) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
     const auto& t_inference1 = std::chrono::steady_clock::now();
 
     /*** PostProcess ***/
     const auto& t_post_process0 = std::chrono::steady_clock::now();
-    std::vector<float> loc_row(output_tensor_info_list_[0].GetDataAsFloat(), output_tensor_info_list_[0].GetDataAsFloat() + output_tensor_info_list_[0].GetElementNum());
-    std::vector<float> loc_col(output_tensor_info_list_[1].GetDataAsFloat(), output_tensor_info_list_[1].GetDataAsFloat() + output_tensor_info_list_[1].GetElementNum());
-    std::vector<float> exist_row(output_tensor_info_list_[2].GetDataAsFloat(), output_tensor_info_list_[2].GetDataAsFloat() + output_tensor_info_list_[2].GetElementNum());
-    std::vector<float> exist_col(output_tensor_info_list_[3].GetDataAsFloat(), output_tensor_info_list_[3].GetDataAsFloat() + output_tensor_info_list_[3].GetElementNum());
-    std::vector<int32_t> loc_row_dims = output_tensor_info_list_[0].tensor_dims;
-    std::vector<int32_t> loc_col_dims = output_tensor_info_list_[1].tensor_dims;
-    std::vector<int32_t> exist_row_dims = output_tensor_info_list_[2].tensor_dims;
-    std::vector<int32_t> exist_col_dims = output_tensor_info_list_[3].tensor_dims;
+    std::vector<float> loc_row(session->output_tensor_info_list[0].GetDataAsFloat(), session->output_tensor_info_list[0].GetDataAsFloat() + session->output_tensor_info_list[0].GetElementNum());
+    std::vector<float> loc_col(session->output_tensor_info_list[1].GetDataAsFloat(), session->output_tensor_info_list[1].GetDataAsFloat() + session->output_tensor_info_list[1].GetElementNum());
+    std::vector<float> exist_row(session->output_tensor_info_list[2].GetDataAsFloat(), session->output_tensor_info_list[2].GetDataAsFloat() + session->output_tensor_info_list[2].GetElementNum());
+    std::vector<float> exist_col(session->output_tensor_info_list[3].GetDataAsFloat(), session->output_tensor_info_list[3].GetDataAsFloat() + session->output_tensor_info_list[3].GetElementNum());
+    std::vector<int32_t> loc_row_dims = session->output_tensor_info_list[0].tensor_dims;
+    std::vector<int32_t> loc_col_dims = session->output_tensor_info_list[1].tensor_dims;
+    std::vector<int32_t> exist_row_dims = session->output_tensor_info_list[2].tensor_dims;
+    std::vector<int32_t> exist_col_dims = session->output_tensor_info_list[3].tensor_dims;
 
-    auto line_list = Pred2Coords(loc_row, loc_row_dims, exist_row, exist_row_dims, loc_col, loc_col_dims, exist_col, exist_col_dims);
+    auto line_list = Pred2Coords(session->row_anchor, session->col_anchor, loc_row, loc_row_dims, exist_row, exist_row_dims, loc_col, loc_col_dims, exist_col, exist_col_dims);
 
     /* todo: I'm not sure the following code correct */
     /* Adjust height scale : https://github.com/cfzd/Ultra-Fast-Lane-Detection-v2/blob/c80276bc2fd67d02579b6eeb57a76cb5a905aa3d/demo.py#L88 */
     /* It looks the demo code run inference with height = model_input_height / 0.6 . but our code cannot do this. so after running inference with height = model_input_height, adjust y position */
-    const float kInferenceHeight = input_tensor_info.GetHeight() / kCropRatio;
+    const float kInferenceHeight = input_tensor_info.GetHeight() / param.crop_ratio;
     for (auto& line : line_list) {
         for (auto& p : line) {
             p.second = ((p.second * kInferenceHeight) - (kInferenceHeight - input_tensor_info.GetHeight())) / input_tensor_info.GetHeight();
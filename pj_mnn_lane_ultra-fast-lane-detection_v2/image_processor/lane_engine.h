@@ -22,6 +22,9 @@ limitations under the License.
 #include <vector>
 #include <array>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -57,27 +60,71 @@ public:
         {}
     } Result;
 
+    enum {
+        kDatasetCulane = 0,
+        kDatasetTusimple,
+        kDatasetCurvelanes,
+    };
+
+    typedef struct ModelConfig_ {
+        std::string model_name;
+        int32_t     height;
+        int32_t     width;
+        int32_t     dataset;    /* kDatasetXXX the model is trained with */
+        std::string input_name;
+        std::vector<std::string> output_name_list;  /* loc_row, loc_col, exist_row, exist_col (+ 2 extra outputs for CurveLanes) */
+        ModelConfig_() : height(0), width(0), dataset(kDatasetCulane) {}
+    } ModelConfig;
+
 public:
-    LaneEngine() {}
-    ~LaneEngine() {}
-    int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
+    LaneEngine() : is_reloading_(false), num_threads_(1) {}
+    ~LaneEngine() {
+        if (reload_thread_.joinable()) reload_thread_.join();
+    }
+    static ModelConfig CreateDefaultModelConfig(void);
+    /* Overwrite model_config with the values in the config file ("key=value" lines). Keys which are not in the file are kept */
+    /*   model_name=s, height=n, width=n, dataset=n (kDatasetXXX), input_name=s, output_name_list=s0 s1 ... */
+    static int32_t ReadModelConfig(const std::string& filename, ModelConfig& model_config);
+    int32_t Initialize(const std::string& work_dir, const int32_t num_threads, const ModelConfig& model_config = CreateDefaultModelConfig());
     int32_t Finalize(void);
+    int32_t Warmup(int32_t iterations);
+    /* Load the model on a background thread. It is swapped in between frames when ready, and the current one is used until then */
+    int32_t Reload(const ModelConfig& model_config);
+    bool IsReloading(void) const { return is_reloading_; }
     int32_t Process(const cv::Mat& original_mat, Result& result);
 
-    void GenerateAnchor();
-    std::vector<Line<float>> Pred2Coords(const std::vector<float>& loc_row, const std::vector<int32_t>& loc_row_dims, const std::vector<float>& exist_row, const std::vector<int32_t>& exist_row_dims,
+    static void GenerateAnchor(int32_t dataset, std::vector<float>& row_anchor, std::vector<float>& col_anchor);
+    static std::vector<Line<float>> Pred2Coords(const std::vector<float>& row_anchor, const std::vector<float>& col_anchor,
+        const std::vector<float>& loc_row, const std::vector<int32_t>& loc_row_dims, const std::vector<float>& exist_row, const std::vector<int32_t>& exist_row_dims,
         const std::vector<float>& loc_col, const std::vector<int32_t>& loc_col_dims, const std::vector<float>& exist_col, const std::vector<int32_t>& exist_col_dims);
 
 private:
+    /* Everything depending on the model. Replaced at once by Reload */
+    typedef struct Session_ {
+        ModelConfig model_config;
+        std::unique_ptr<InferenceHelper> inference_helper;
+        std::vector<InputTensorInfo> input_tensor_info_list;
+        std::vector<OutputTensorInfo> output_tensor_info_list;
+        std::vector<float> row_anchor;
+        std::vector<float> col_anchor;
+        ~Session_() {
+            if (inference_helper) inference_helper->Finalize();
+        }
+    } Session;
 
 private:
-    std::unique_ptr<InferenceHelper> inference_helper_;
-    std::vector<InputTensorInfo> input_tensor_info_list_;
-    std::vector<OutputTensorInfo> output_tensor_info_list_;
-
-    std::vector<float> row_anchor_;
-    std::vector<float> col_anchor_;
+    int32_t CreateSession(const ModelConfig& model_config, std::shared_ptr<Session>& session);
+    void SwapSession(void);
 
+private:
+    std::shared_ptr<Session> session_;
+    std::shared_ptr<Session> session_reloaded_;     /* created by the reload thread */
+    std::mutex reload_mutex_;                       /* for session_reloaded_ */
+    std::thread reload_thread_;
+    std::atomic<bool> is_reloading_;
+
+    std::string work_dir_;
+    int32_t num_threads_;
 };
 
 #endif
@@ -62,6 +62,8 @@ int32_t main(int argc, char* argv[])
         return -1;
     }
 
+    ImageProcessor::Warmup();
+
     /*** Process for each frame ***/
     int32_t frame_cnt = 0;
     for (frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
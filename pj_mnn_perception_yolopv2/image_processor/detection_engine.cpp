@@ -120,6 +120,21 @@ int32_t DetectionEngine::Finalize()
     return kRetOk;
 }
 
+
+int32_t DetectionEngine::Warmup(int32_t iterations)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    const bool is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), iterations, [this](const cv::Mat& mat) {
+        Result result;
+        return Process(mat, result) == kRetOk;
+    });
+    return is_ok ? kRetOk : kRetErr;
+}
+
 /* reference: https://github.com/CAIC-AD/YOLOPv2/blob/main/utils/utils.py#L170 */
 /* [1,255,48,80] = [1, 3, 85, 48, 80] = [1, 3, (x, y, w, h, prob, prob x80), ny nx] */
 std::vector<BoundingBox> DetectionEngine::GetBoundingBox(std::vector<float> pred, int32_t input_width, int32_t input_height, int32_t st, const float anchor_grid[3][2], float scale_w, float scale_h)
@@ -64,6 +64,7 @@ public:
     ~DetectionEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
     int32_t Finalize(void);
+    int32_t Warmup(int32_t iterations);
     int32_t Process(const cv::Mat& original_mat, Result& result);
 
 private:
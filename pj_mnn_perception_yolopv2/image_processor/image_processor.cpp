@@ -43,17 +43,37 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+static constexpr double kBlendAlphaImage = 0.8;         /* result = image * kBlendAlphaImage + segmentation color * kBlendAlphaSeg */
+static constexpr double kBlendAlphaSeg = 0.5;
+
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_engine;
 Tracker s_tracker;
 CommonHelper::NiceColorGenerator s_nice_color_generator;
+FrameSkipController s_frame_skip_controller;
+
+/* Text drawn in every frame. Glyphs and texts are cached in each renderer */
+static CommonHelper::TextRenderer s_text_renderer_fps(0.5, 2);
+static CommonHelper::TextRenderer s_text_renderer_label(0.35, 1);
+static CommonHelper::TextRenderer s_text_renderer_info(0.7, 2);
+
+/* For segmentation drawing */
+static std::array<cv::Vec3b, 256> s_seg_color_lut;  /* color for each class index */
+static std::vector<int32_t> s_seg_x_index;          /* x on the segmentation map for each x on the image (nearest neighbor) */
+static std::vector<int32_t> s_seg_y_index;
+static cv::Size s_seg_index_image_size;             /* the index tables are created for this pair of sizes */
+static cv::Size s_seg_index_seg_size;
 
 /* For top view transform */
 static CameraModel s_camera_real;
 static CameraModel s_camera_top;
 static cv::Mat s_mat_transform_topview;
-#define COLOR_BG  CommonHelper::CreateCvColor(70, 70, 70)
 static cv::Size s_size_topview;
+static std::vector<int32_t> s_topview_lut;          /* index of the pixel on the segmentation map for each top view pixel. -1 = out of the source image */
+static cv::Size s_topview_lut_src_size;             /* the LUT is created for this size of source image */
+static cv::Size s_topview_lut_seg_size;             /* and this size of segmentation map */
+static cv::Mat s_mat_topview_overlay;               /* static grid lines and distance labels */
+static cv::Mat s_mat_topview_overlay_mask;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -64,7 +84,7 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
     double fps = 1e9 / (time_now - time_previous).count();
     time_previous = time_now;
     snprintf(text, sizeof(text), "FPS: %.1f, Inference: %.1f [ms]", fps, time_inference);
-    CommonHelper::DrawText(mat, text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
+    s_text_renderer_fps.Draw(mat, text, cv::Point(0, 0), CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true, false);
 }
 
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
@@ -80,6 +100,33 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         s_engine.reset();
         return -1;
     }
+
+    s_seg_color_lut.fill(cv::Vec3b(0, 0, 0));
+    s_seg_color_lut[1] = cv::Vec3b(0, 255, 0);
+    s_seg_color_lut[2] = cv::Vec3b(0, 0, 255);
+    return 0;
+}
+
+int32_t ImageProcessor::Warmup(int32_t iterations)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+
+    if (s_engine->Warmup(iterations) != DetectionEngine::kRetOk) {
+        return -1;
+    }
+    return 0;
+}
+
+int32_t ImageProcessor::SetFrameRate(double fps)
+{
+    if (fps <= 0) {
+        PRINT_E("Invalid frame rate (%f)\n", fps);
+        return -1;
+    }
+    s_tracker.SetFrameInterval(1.0 / fps);
     return 0;
 }
 
@@ -107,21 +154,18 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
     switch (cmd) {
     case 0:
+        /* Toggle adaptive frame skip (detection every k frames, tracker prediction only in-between frames) */
+        s_frame_skip_controller.SetEnabled(!s_frame_skip_controller.IsEnabled());
+        PRINT("Adaptive frame skip: %s\n", s_frame_skip_controller.IsEnabled() ? "ON" : "OFF");
+        return 0;
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
         return -1;
     }
 }
 
-static void CreateTopViewMat(const cv::Mat& mat_original, cv::Mat& mat_topview)
+static void DrawTopViewGrid(cv::Mat& mat, cv::Scalar color_line, cv::Scalar color_text_front, cv::Scalar color_text_back)
 {
-    /* Perspective Transform */
-    mat_topview = cv::Mat(cv::Size(s_camera_top.width, s_camera_top.height), CV_8UC3, COLOR_BG);
-    //cv::warpPerspective(mat_original, mat_topview, s_mat_transform_topview, mat_topview.size(), cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
-    cv::warpPerspective(mat_original, mat_topview, s_mat_transform_topview, mat_topview.size(), cv::INTER_NEAREST);
-
-#if 1
-    /* Display Grid lines */
     static constexpr int32_t kDepthInterval = 5;
     static constexpr int32_t kHorizontalRange = 10;
     std::vector<cv::Point3f> object_point_list;
@@ -133,14 +177,136 @@ static void CreateTopViewMat(const cv::Mat& mat_original, cv::Mat& mat_topview)
     cv::projectPoints(object_point_list, s_camera_top.rvec, s_camera_top.tvec, s_camera_top.K, s_camera_top.dist_coeff, image_point_list);
     for (int32_t i = 0; i < static_cast<int32_t>(image_point_list.size()); i++) {
         if (i % 2 != 0) {
-            cv::line(mat_topview, image_point_list[i - 1], image_point_list[i], cv::Scalar(255, 255, 255));
+            cv::line(mat, image_point_list[i - 1], image_point_list[i], color_line);
         } else {
-            CommonHelper::DrawText(mat_topview, std::to_string(i / 2 * kDepthInterval) + "[m]", image_point_list[i], 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(255, 255, 255), false);
+            CommonHelper::DrawText(mat, std::to_string(i / 2 * kDepthInterval) + "[m]", image_point_list[i], 0.5, 2, color_text_front, color_text_back, false);
+        }
+    }
+}
+
+static void CreateSegIndex(const cv::Size& image_size, const cv::Size& seg_size)
+{
+    /* The same mapping as cv::resize(INTER_NEAREST) from the segmentation map to the image */
+    const double scale_x = static_cast<double>(seg_size.width) / image_size.width;
+    const double scale_y = static_cast<double>(seg_size.height) / image_size.height;
+    s_seg_x_index.resize(image_size.width);
+    for (int32_t x = 0; x < image_size.width; x++) {
+        s_seg_x_index[x] = (std::min)(cvFloor(x * scale_x), seg_size.width - 1);
+    }
+    s_seg_y_index.resize(image_size.height);
+    for (int32_t y = 0; y < image_size.height; y++) {
+        s_seg_y_index[y] = (std::min)(cvFloor(y * scale_y), seg_size.height - 1);
+    }
+    s_seg_index_image_size = image_size;
+    s_seg_index_seg_size = seg_size;
+}
+
+static void DrawSegmentation(cv::Mat& mat, const cv::Mat& mat_seg, const std::array<cv::Vec3b, 256>& color_lut, double alpha_image, double alpha_seg)
+{
+    /* Same result as merge + LUT + resize(INTER_NEAREST) of mat_seg then addWeighted with mat, */
+    /* but blend directly into mat in a single pass without any full size buffer */
+    if (mat.size() != s_seg_index_image_size || mat_seg.size() != s_seg_index_seg_size) {
+        CreateSegIndex(mat.size(), mat_seg.size());
+    }
+
+    /* Weighted values in fixed point (8-bit fraction) */
+    std::array<int32_t, 256> weighted_image;
+    for (int32_t i = 0; i < 256; i++) {
+        weighted_image[i] = static_cast<int32_t>(std::round(alpha_image * i * 256));
+    }
+    std::array<std::array<int32_t, 3>, 256> weighted_color;
+    for (int32_t i = 0; i < 256; i++) {
+        for (int32_t c = 0; c < 3; c++) {
+            weighted_color[i][c] = static_cast<int32_t>(std::round(alpha_seg * color_lut[i][c] * 256)) + 128;    /* +128 for rounding */
+        }
+    }
+
+    const int32_t width = mat.cols;
+    const int32_t height = mat.rows;
+    const int32_t* x_index = s_seg_x_index.data();
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t* seg = mat_seg.ptr<uint8_t>(s_seg_y_index[y]);
+        uint8_t* dst = mat.ptr<uint8_t>(y);
+        for (int32_t x = 0; x < width; x++) {
+            const auto& color = weighted_color[seg[x_index[x]]];
+            dst[x * 3 + 0] = static_cast<uint8_t>((std::min)(255, (weighted_image[dst[x * 3 + 0]] + color[0]) >> 8));
+            dst[x * 3 + 1] = static_cast<uint8_t>((std::min)(255, (weighted_image[dst[x * 3 + 1]] + color[1]) >> 8));
+            dst[x * 3 + 2] = static_cast<uint8_t>((std::min)(255, (weighted_image[dst[x * 3 + 2]] + color[2]) >> 8));
+        }
+    }
+}
+
+static void CreateTopViewLut(const cv::Size& src_size, const cv::Size& seg_size)
+{
+    /* Mapping of cv::warpPerspective(INTER_NEAREST, BORDER_CONSTANT) is constant, so calculate the source pixel for each destination pixel only once */
+    cv::Mat mat_transform_inv;
+    cv::invert(s_mat_transform_topview, mat_transform_inv);
+    const double* m = mat_transform_inv.ptr<double>();
+    const int32_t width = s_size_topview.width;
+    const int32_t height = s_size_topview.height;
+    s_topview_lut.resize(static_cast<size_t>(width) * height);
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            int32_t index = -1;
+            double w = m[6] * x + m[7] * y + m[8];
+            if (w != 0) {
+                int32_t src_x = cvRound((m[0] * x + m[1] * y + m[2]) / w);
+                int32_t src_y = cvRound((m[3] * x + m[4] * y + m[5]) / w);
+                if (src_x >= 0 && src_x < src_size.width && src_y >= 0 && src_y < src_size.height) {
+                    /* nearest pixel on the segmentation map, the same as cv::resize(INTER_NEAREST) to the source size */
+                    const int32_t seg_x = (std::min)(cvFloor(src_x * static_cast<double>(seg_size.width) / src_size.width), seg_size.width - 1);
+                    const int32_t seg_y = (std::min)(cvFloor(src_y * static_cast<double>(seg_size.height) / src_size.height), seg_size.height - 1);
+                    index = seg_y * seg_size.width + seg_x;
+                }
+            }
+            s_topview_lut[y * width + x] = index;
         }
     }
+    s_topview_lut_src_size = src_size;
+    s_topview_lut_seg_size = seg_size;
+
+    /* Grid is static, so draw it only once. The mask is drawn with the same primitives to know the pixels to be overwritten */
+    s_mat_topview_overlay = cv::Mat::zeros(s_size_topview, CV_8UC3);
+    s_mat_topview_overlay_mask = cv::Mat::zeros(s_size_topview, CV_8UC1);
+#if 1
+    /* Display Grid lines */
+    DrawTopViewGrid(s_mat_topview_overlay, cv::Scalar(255, 255, 255), CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(255, 255, 255));
+    DrawTopViewGrid(s_mat_topview_overlay_mask, cv::Scalar(255), cv::Scalar(255), cv::Scalar(255));
 #endif
 }
 
+static void CreateTopViewMat(const cv::Size& src_size, const cv::Mat& mat_seg, const std::array<cv::Vec3b, 256>& color_lut, cv::Mat& mat_topview)
+{
+    if (src_size != s_topview_lut_src_size || mat_seg.size() != s_topview_lut_seg_size) {
+        CreateTopViewLut(src_size, mat_seg.size());
+    }
+
+    /* Colorize, resize to the source size, Perspective Transform and the grid overlay in a single gather */
+    cv::Mat mat_src = mat_seg.isContinuous() ? mat_seg : mat_seg.clone();
+    const uint8_t* src = mat_src.ptr<uint8_t>();
+    const int32_t width = s_size_topview.width;
+    const int32_t height = s_size_topview.height;
+    mat_topview.create(s_size_topview, CV_8UC3);
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        const int32_t* lut = s_topview_lut.data() + y * width;
+        const uint8_t* overlay_mask = s_mat_topview_overlay_mask.ptr<uint8_t>(y);
+        const cv::Vec3b* overlay = s_mat_topview_overlay.ptr<cv::Vec3b>(y);
+        cv::Vec3b* dst = mat_topview.ptr<cv::Vec3b>(y);
+        for (int32_t x = 0; x < width; x++) {
+            if (overlay_mask[x]) {
+                dst[x] = overlay[x];
+            } else if (lut[x] >= 0) {
+                dst[x] = color_lut[src[lut[x]]];
+            } else {
+                dst[x] = cv::Vec3b(0, 0, 0);
+            }
+        }
+    }
+}
+
 static void CreateTransformMat(int32_t width, int32_t height, float fov_deg)
 {
     /*** Set camera parameters ***/
@@ -170,10 +336,11 @@ static void CreateTransformMat(int32_t width, int32_t height, float fov_deg)
     cv::projectPoints(object_point_list, s_camera_top.rvec, s_camera_top.tvec, s_camera_top.K, s_camera_top.dist_coeff, image_point_top_list);
 
     s_mat_transform_topview = cv::getPerspectiveTransform(&image_point_real_list[0], &image_point_top_list[0]);
+    s_topview_lut_src_size = cv::Size();    /* LUT is re-created at the next frame */
 }
 
 
-int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
+int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result, double timestamp)
 {
     if (!s_engine) {
         PRINT_E("Not initialized\n");
@@ -188,29 +355,26 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /*** Call inference ***/
+    /* In adaptive frame skip mode, inference runs every few frames. The previous segmentation is used in-between frames */
+    static cv::Mat s_mat_seg_max_previous;
+    const bool is_detection_frame = s_frame_skip_controller.IsDetectionFrame() || s_mat_seg_max_previous.empty();
+
     DetectionEngine::Result det_result;
-    if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
-        return -1;
-    }
+    if (is_detection_frame) {
+        if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
+            return -1;
+        }
+        s_mat_seg_max_previous = det_result.mat_seg_max;     /* created for each frame and never modified, so no need to copy */
 
-    /*** Draw target area  ***/
-    cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
+        /*** Draw target area  ***/
+        cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
+    } else {
+        det_result.mat_seg_max = s_mat_seg_max_previous;
+    }
 
     /*** Draw segmentation image for the class of the highest score ***/
-    cv::Mat& mat_seg_max = det_result.mat_seg_max;
-    cv::Mat mat_seg_max_list[] = { mat_seg_max, mat_seg_max, mat_seg_max };
-    cv::merge(mat_seg_max_list, 3, mat_seg_max);
-    cv::Mat mat_lut = cv::Mat::zeros(256, 1, CV_8UC3);
-    mat_lut.at<cv::Vec3b>(0) = cv::Vec3b(0, 0, 0);
-    mat_lut.at<cv::Vec3b>(1) = cv::Vec3b(0, 255, 0);
-    mat_lut.at<cv::Vec3b>(2) = cv::Vec3b(0, 0, 255);
-    cv::LUT(mat_seg_max, mat_lut, mat_seg_max);
-    cv::resize(mat_seg_max, mat_seg_max, mat.size(), 0.0, 0.0, cv::INTER_NEAREST);
-    cv::Mat mat_masked;
-    cv::addWeighted(mat, 0.8, mat_seg_max, 0.5, 0, mat_masked);
-    //cv::add(mat_seg_max * kResultMixRatio, mat * (1.0f - kResultMixRatio), mat_masked);
-    //cv::hconcat(mat, mat_masked, mat);
-    mat = mat_masked;
+    const cv::Mat& mat_seg_max = det_result.mat_seg_max;
+    DrawSegmentation(mat, mat_seg_max, s_seg_color_lut, kBlendAlphaImage, kBlendAlphaSeg);
 
     /*** Draw detection result (black rectangle) ***/
     int32_t num_det = 0;
@@ -220,7 +384,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /*** Draw tracking result ***/
-    s_tracker.Update(det_result.bbox_list);
+    s_frame_skip_controller.UpdateTracker(s_tracker, is_detection_frame, det_result.bbox_list, det_result.time_pre_process + det_result.time_inference + det_result.time_post_process, timestamp);
     int32_t num_track = 0;
     auto& track_list = s_tracker.GetTrackList();
     for (auto& track : track_list) {
@@ -229,7 +393,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         /* Use white rectangle for the object which was not detected but just predicted */
         cv::Scalar color = bbox.score == 0 ? CommonHelper::CreateCvColor(255, 255, 255) : s_nice_color_generator.Get(track.GetId());
         cv::rectangle(mat, cv::Rect(bbox.x, bbox.y, bbox.w, bbox.h), color, 2);
-        CommonHelper::DrawText(mat, std::to_string(track.GetId()) + ": " + bbox.label, cv::Point(bbox.x, bbox.y - 13), 0.35, 1, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
+        s_text_renderer_label.Draw(mat, std::to_string(track.GetId()) + ": " + bbox.label, cv::Point(bbox.x, bbox.y - 13), CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
 
         auto& track_history = track.GetDataHistory();
         for (size_t i = 1; i < track_history.size(); i++) {
@@ -239,11 +403,11 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         }
         num_track++;
     }
-    CommonHelper::DrawText(mat, "DET: " + std::to_string(num_det) + ", TRACK: " + std::to_string(num_track), cv::Point(0, 20), 0.7, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
+    s_text_renderer_info.Draw(mat, "DET: " + std::to_string(num_det) + ", TRACK: " + std::to_string(num_track), cv::Point(0, 20), CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
 
     /*** Draw top view ***/
     cv::Mat mat_topview;
-    CreateTopViewMat(mat_seg_max, mat_topview);
+    CreateTopViewMat(mat.size(), mat_seg_max, s_seg_color_lut, mat_topview);
     /* Draw object on top view */
     std::vector<cv::Point2f> normal_points;
     std::vector<cv::Point2f> topview_points;
@@ -43,9 +43,14 @@ typedef struct {
 } Result;
 
 int32_t Initialize(const InputParam& input_param);
-int32_t Process(cv::Mat& mat, Result& result);
+/* timestamp [sec]: time of the frame (e.g. position in the video file) for the tracker. 1 frame interval is assumed if not given (< 0) */
+int32_t Process(cv::Mat& mat, Result& result, double timestamp = -1.0);
+/* Frame rate of the source, which is the unit of time for the tracker */
+int32_t SetFrameRate(double fps);
 int32_t Finalize(void);
 int32_t Command(int32_t cmd);
+/* Run the engines with synthetic images (CommonHelper::RunWarmup). Call after Initialize */
+int32_t Warmup(int32_t iterations = 2);
 
 }
 
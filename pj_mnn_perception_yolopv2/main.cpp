@@ -62,6 +62,13 @@ int32_t main(int argc, char* argv[])
         return -1;
     }
 
+    ImageProcessor::Warmup();
+
+    /* Tracker works in the unit of the frame interval of the source */
+    if (cap.isOpened() && cap.get(cv::CAP_PROP_FPS) > 0) {
+        ImageProcessor::SetFrameRate(cap.get(cv::CAP_PROP_FPS));
+    }
+
     /*** Process for each frame ***/
     int32_t frame_cnt = 0;
     for (frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
@@ -69,8 +76,10 @@ int32_t main(int argc, char* argv[])
         /* Read image */
         const auto& time_cap0 = std::chrono::steady_clock::now();
         cv::Mat image;
+        double timestamp = -1.0;
         if (cap.isOpened()) {
             cap.read(image);
+            timestamp = CommonHelper::GetFrameTimestamp(cap);
         } else {
             image = cv::imread(input_name);
         }
@@ -80,7 +89,7 @@ int32_t main(int argc, char* argv[])
         /* Call image processor library */
         const auto& time_image_process0 = std::chrono::steady_clock::now();
         ImageProcessor::Result result;
-        ImageProcessor::Process(image, result);
+        ImageProcessor::Process(image, result, timestamp);
         const auto& time_image_process1 = std::chrono::steady_clock::now();
 
         /* Display result */
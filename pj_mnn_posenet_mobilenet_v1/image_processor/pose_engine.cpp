@@ -338,6 +338,21 @@ int32_t PoseEngine::Finalize()
 }
 
 
+int32_t PoseEngine::Warmup(int32_t iterations)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    const bool is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), iterations, [this](const cv::Mat& mat) {
+        Result result;
+        return Process(mat, result) == kRetOk;
+    });
+    return is_ok ? kRetOk : kRetErr;
+}
+
+
 int32_t PoseEngine::Process(const cv::Mat& original_mat, Result& result)
 {
     if (!inference_helper_) {
@@ -34,6 +34,9 @@
 #define IS_RGB      true
 #define OUTPUT_NAME  "ResizeBilinear_3"
 
+/* Number of rows processed by a thread at a time in post process */
+static constexpr int32_t kRowBlockSize = 8;
+
 
 /*** Function ***/
 int32_t SemanticSegmentationEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
@@ -72,6 +75,8 @@ int32_t SemanticSegmentationEngine::Initialize(const std::string& work_dir, cons
         return kRetErr;
     }
 
+    CreatePalette();
+
     return kRetOk;
 }
 
@@ -86,6 +91,75 @@ int32_t SemanticSegmentationEngine::Finalize()
 }
 
 
+int32_t SemanticSegmentationEngine::Warmup(int32_t iterations)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    const bool is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), iterations, [this](const cv::Mat& mat) {
+        Result result;
+        return Process(mat, result) == kRetOk;
+    });
+    return is_ok ? kRetOk : kRetErr;
+}
+
+
+void SemanticSegmentationEngine::CreatePalette()
+{
+    /* Color for each class is calculated only once here, instead of for each pixel */
+    for (int32_t i = 0; i < static_cast<int32_t>(palette_.size()); i++) {
+        float color_ratio_b = (i % 2 + 1) / 2.0f;
+        float color_ratio_g = (i % 3 + 1) / 3.0f;
+        float color_ratio_r = (i % 4 + 1) / 4.0f;
+        palette_[i] = cv::Vec3b(
+            static_cast<uint8_t>(255 * color_ratio_b),
+            static_cast<uint8_t>(255 * color_ratio_g),
+            static_cast<uint8_t>(255 * (1 - color_ratio_r)));
+    }
+}
+
+void SemanticSegmentationEngine::ArgMax(const float* values, int32_t width, int32_t height, int32_t channel, cv::Mat& class_map, cv::Mat& mask_image)
+{
+    /* values is NCHW. Loop order is (row, channel, x) so that the innermost loop reads contiguous memory and is vectorized */
+    class_map = cv::Mat(height, width, CV_8UC1);
+    if (is_colorize_) {
+        mask_image = cv::Mat(height, width, CV_8UC3);
+    }
+    const int32_t area = width * height;
+    const int32_t num_block = (height + kRowBlockSize - 1) / kRowBlockSize;
+#pragma omp parallel for
+    for (int32_t block = 0; block < num_block; block++) {
+        std::vector<float> max_value_list(width);
+        float* max_value = max_value_list.data();
+        const int32_t y_end = (std::min)(height, (block + 1) * kRowBlockSize);
+        for (int32_t y = block * kRowBlockSize; y < y_end; y++) {
+            uint8_t* class_index = class_map.ptr<uint8_t>(y);
+            const float* value_0 = values + y * width;
+            std::copy(value_0, value_0 + width, max_value);
+            std::fill(class_index, class_index + width, static_cast<uint8_t>(0));
+            for (int32_t c = 1; c < channel; c++) {
+                const float* value_c = values + c * area + y * width;
+                const uint8_t c_u8 = static_cast<uint8_t>(c);
+#pragma omp simd
+                for (int32_t x = 0; x < width; x++) {
+                    const bool is_greater = value_c[x] > max_value[x];
+                    max_value[x] = is_greater ? value_c[x] : max_value[x];
+                    class_index[x] = is_greater ? c_u8 : class_index[x];
+                }
+            }
+
+            if (is_colorize_) {
+                cv::Vec3b* color = mask_image.ptr<cv::Vec3b>(y);
+                for (int32_t x = 0; x < width; x++) {
+                    color[x] = palette_[class_index[x]];
+                }
+            }
+        }
+    }
+}
+
 int32_t SemanticSegmentationEngine::Process(const cv::Mat& original_mat, Result& result)
 {
     if (!inference_helper_) {
@@ -130,37 +204,22 @@ int32_t SemanticSegmentationEngine::Process(const cv::Mat& original_mat, Result&
 
     /*** PostProcess ***/
     const auto& t_post_process0 = std::chrono::steady_clock::now();
-    /* Create mask image */
-    int32_t outputWidth = output_tensor_info_list_[0].tensor_dims[3];
-    int32_t outputHeight = output_tensor_info_list_[0].tensor_dims[2];
-    int32_t outputCannel = output_tensor_info_list_[0].tensor_dims[1];
-    float* values = static_cast<float*>(output_tensor_info_list_[0].data);
-    cv::Mat mask_image = cv::Mat::zeros(outputHeight, outputWidth, CV_8UC3);
-    for (int32_t y = 0; y < outputHeight; y++) {
-        for (int32_t x = 0; x < outputWidth; x++) {
-            int32_t maxChannel = 0;
-            float maxValue = 0;
-            for (int32_t c = 0; c < outputCannel; c++) {
-                //float value = values[y * (outputWidth * outputCannel) + x * outputCannel + c];	// NHWC
-                float value = values[c * (outputWidth * outputHeight) + y * outputWidth + x];	// NCHW
-                if (value > maxValue) {
-                    maxValue = value;
-                    maxChannel = c;
-                }
-            }
-
-            float colorRatioB = (maxChannel % 2 + 1) / 2.0f;
-            float colorRatioG = (maxChannel % 3 + 1) / 3.0f;
-            float colorRatioR = (maxChannel % 4 + 1) / 4.0f;
-            mask_image.data[(y * outputWidth + x) * 3 + 0] = (int)(255 * colorRatioB);
-            mask_image.data[(y * outputWidth + x) * 3 + 1] = (int)(255 * colorRatioG);
-            mask_image.data[(y * outputWidth + x) * 3 + 2] = (int)(255 * (1 - colorRatioR));
-
-        }
+    /* Create class map (and mask image) */
+    int32_t output_width = output_tensor_info_list_[0].tensor_dims[3];
+    int32_t output_height = output_tensor_info_list_[0].tensor_dims[2];
+    int32_t output_channel = output_tensor_info_list_[0].tensor_dims[1];
+    if (output_channel > static_cast<int32_t>(palette_.size())) {
+        PRINT_E("Too many classes (%d)\n", output_channel);
+        return kRetErr;
     }
+    const float* values = output_tensor_info_list_[0].GetDataAsFloat();
+    cv::Mat class_map;
+    cv::Mat mask_image;
+    ArgMax(values, output_width, output_height, output_channel, class_map, mask_image);
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
     /* Return the results */
+    result.class_map = class_map;
     result.mask_image = mask_image;
     result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
     result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
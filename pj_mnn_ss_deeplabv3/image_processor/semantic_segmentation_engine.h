@@ -24,7 +24,8 @@ public:
     };
 
     typedef struct Result_ {
-        cv::Mat   mask_image;
+        cv::Mat   class_map;            // [height, width, 1]. value is class index (uint8_t)
+        cv::Mat   mask_image;           // [height, width, 3]. colorized class_map. empty when colorization is disabled
         double    time_pre_process;		// [msec]
         double    time_inference;		// [msec]
         double    time_post_process;	// [msec]
@@ -33,16 +34,29 @@ public:
     } Result;
 
 public:
-    SemanticSegmentationEngine() {}
+    SemanticSegmentationEngine(bool is_colorize = true) {
+        is_colorize_ = is_colorize;
+    }
     ~SemanticSegmentationEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
     int32_t Finalize(void);
+    int32_t Warmup(int32_t iterations);
     int32_t Process(const cv::Mat& original_mat, Result& result);
+    void SetColorize(bool is_colorize) {
+        is_colorize_ = is_colorize;
+    }
+
+private:
+    void CreatePalette();
+    void ArgMax(const float* values, int32_t width, int32_t height, int32_t channel, cv::Mat& class_map, cv::Mat& mask_image);
 
 private:
     std::unique_ptr<InferenceHelper> inference_helper_;
     std::vector<InputTensorInfo> input_tensor_info_list_;
     std::vector<OutputTensorInfo> output_tensor_info_list_;
+
+    bool is_colorize_;
+    std::array<cv::Vec3b, 256> palette_;
 };
 
 #endif
@@ -59,6 +59,8 @@ int32_t main(int argc, char* argv[])
     ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
     ImageProcessor::Initialize(input_param);
 
+    ImageProcessor::Warmup();
+
     /*** Process for each frame ***/
     int32_t frame_cnt = 0;
     for (frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
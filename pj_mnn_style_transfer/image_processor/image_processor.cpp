@@ -11,6 +11,11 @@
 #include <chrono>
 #include <fstream>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <map>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -27,12 +32,43 @@
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+static constexpr int32_t kNumStyleImage = 31;   /* style0.jpg - style30.jpg */
+#define STYLE_BOTTLENECK_CACHE_NAME "style_bottleneck.cache"
+static constexpr char kStyleBottleneckCacheMagic[4] = { 'S', 'B', 'N', 'C' };
+static constexpr int32_t kStyleBottleneckCacheVersion = 1;
+static constexpr bool kIsParallelInitialize = true;     /* initialize the engines on separate threads */
+static constexpr int32_t kNumTileSession = 2;      /* sessions to process tiles in parallel in tiled mode */
+
 /*** Global variable ***/
 std::unique_ptr<StylePredictionEngine> s_style_prediction_engine;
 std::unique_ptr<StyleTransferEngine> s_style_transfer_engine;
 float s_style_bottleneck[StylePredictionEngine::SIZE_STYLE_BOTTLENECK];
 std::string s_work_dir;
 bool s_style_bottleneck_updated = true;
+bool s_is_tiled_mode = false;   /* Stylize in full resolution by tiles (Command(3)) */
+
+/* Merged style bottleneck (double buffer). s_merged_style_bottleneck_index points to the latest completed one */
+/* The worker writes only the other buffer, and a new request is issued only after style transfer finishes using the current one */
+static float s_merged_style_bottleneck[2][StylePredictionEngine::SIZE_STYLE_BOTTLENECK];
+static std::atomic<int32_t> s_merged_style_bottleneck_index(0);
+
+/* Worker to calculate the merged style bottleneck in background */
+static std::thread s_worker_thread;
+static std::mutex s_worker_mutex;                   /* for s_worker_mat, s_worker_exit */
+static std::condition_variable s_worker_cv;
+static cv::Mat s_worker_mat;
+static bool s_worker_exit = false;
+static std::atomic<bool> s_worker_busy(false);
+static std::mutex s_style_prediction_mutex;         /* for s_style_prediction_engine, s_style_bottleneck */
+
+/* Style bottleneck of each style image. Calculated only once, and saved to file to be reused in the next run */
+typedef std::array<float, StylePredictionEngine::SIZE_STYLE_BOTTLENECK> StyleBottleneck;
+static std::map<std::string, StyleBottleneck> s_style_bottleneck_list;      /* key = filename */
+static std::map<uint64_t, StyleBottleneck> s_style_bottleneck_cache;        /* key = hash of image file content */
+static bool s_style_bottleneck_cache_dirty = false;
+static std::mutex s_style_bottleneck_cache_mutex;   /* for s_style_bottleneck_list, s_style_bottleneck_cache, s_style_bottleneck_cache_dirty */
+static std::thread s_precompute_thread;
+static std::atomic<bool> s_precompute_exit(false);
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -46,24 +82,219 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
     CommonHelper::DrawText(mat, text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 }
 
-static int32_t CalculateStyleBottleneck(std::string styleFilename)
+static uint64_t CalculateHash(const std::vector<uint8_t>& data)
+{
+    /* FNV-1a */
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto& d : data) {
+        hash ^= d;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void LoadStyleBottleneckCache()
+{
+    std::string path = s_work_dir + "/style/" + STYLE_BOTTLENECK_CACHE_NAME;
+    std::ifstream ifs(path, std::ios::binary);
+    if (ifs.fail()) {
+        return;
+    }
+
+    char magic[4] = { 0 };
+    int32_t version = 0;
+    int32_t size_bottleneck = 0;
+    int32_t num = 0;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&version), sizeof(version));
+    ifs.read(reinterpret_cast<char*>(&size_bottleneck), sizeof(size_bottleneck));
+    ifs.read(reinterpret_cast<char*>(&num), sizeof(num));
+    if (ifs.fail() || std::memcmp(magic, kStyleBottleneckCacheMagic, sizeof(magic)) != 0 || version != kStyleBottleneckCacheVersion || size_bottleneck != StylePredictionEngine::SIZE_STYLE_BOTTLENECK) {
+        PRINT("Ignore invalid cache file: %s\n", path.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(s_style_bottleneck_cache_mutex);
+    for (int32_t i = 0; i < num; i++) {
+        uint64_t hash = 0;
+        StyleBottleneck style_bottleneck;
+        ifs.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+        ifs.read(reinterpret_cast<char*>(style_bottleneck.data()), sizeof(float) * style_bottleneck.size());
+        if (ifs.fail()) break;
+        s_style_bottleneck_cache[hash] = style_bottleneck;
+    }
+}
+
+static void SaveStyleBottleneckCache()
 {
-    std::string path = s_work_dir + "/style/" + styleFilename;
-    cv::Mat style_image = cv::imread(path);
-    if (style_image.empty()) {
+    std::lock_guard<std::mutex> lock(s_style_bottleneck_cache_mutex);
+    if (!s_style_bottleneck_cache_dirty) return;
+
+    std::string path = s_work_dir + "/style/" + STYLE_BOTTLENECK_CACHE_NAME;
+    std::ofstream ofs(path, std::ios::binary);
+    if (ofs.fail()) {
+        PRINT_E("Failed to write %s\n", path.c_str());
+        return;
+    }
+    int32_t size_bottleneck = StylePredictionEngine::SIZE_STYLE_BOTTLENECK;
+    int32_t num = static_cast<int32_t>(s_style_bottleneck_cache.size());
+    ofs.write(kStyleBottleneckCacheMagic, sizeof(kStyleBottleneckCacheMagic));
+    ofs.write(reinterpret_cast<const char*>(&kStyleBottleneckCacheVersion), sizeof(kStyleBottleneckCacheVersion));
+    ofs.write(reinterpret_cast<const char*>(&size_bottleneck), sizeof(size_bottleneck));
+    ofs.write(reinterpret_cast<const char*>(&num), sizeof(num));
+    for (const auto& cache : s_style_bottleneck_cache) {
+        ofs.write(reinterpret_cast<const char*>(&cache.first), sizeof(cache.first));
+        ofs.write(reinterpret_cast<const char*>(cache.second.data()), sizeof(float) * cache.second.size());
+    }
+    s_style_bottleneck_cache_dirty = false;
+}
+
+static int32_t GetStyleBottleneck(const std::string& style_filename, StyleBottleneck& style_bottleneck)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_style_bottleneck_cache_mutex);
+        auto it = s_style_bottleneck_list.find(style_filename);
+        if (it != s_style_bottleneck_list.end()) {
+            style_bottleneck = it->second;
+            return 0;
+        }
+    }
+
+    /* Read file to find it in cache. Calculate it only if not found */
+    std::string path = s_work_dir + "/style/" + style_filename;
+    std::ifstream ifs(path, std::ios::binary);
+    if (ifs.fail()) {
         PRINT("[error] cannot read %s\n", path.c_str());
         return -1;
     }
+    std::vector<uint8_t> file_data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    uint64_t hash = CalculateHash(file_data);
+    bool is_found = false;
+    {
+        std::lock_guard<std::mutex> lock(s_style_bottleneck_cache_mutex);
+        auto it = s_style_bottleneck_cache.find(hash);
+        if (it != s_style_bottleneck_cache.end()) {
+            style_bottleneck = it->second;
+            is_found = true;
+        }
+    }
 
-    StylePredictionEngine::Result style_prediction_result;
-    s_style_prediction_engine->Process(style_image, style_prediction_result);
+    if (!is_found) {
+        cv::Mat style_image = cv::imdecode(file_data, cv::IMREAD_COLOR);
+        if (style_image.empty()) {
+            PRINT("[error] cannot read %s\n", path.c_str());
+            return -1;
+        }
+        std::lock_guard<std::mutex> lock(s_style_prediction_mutex);
+        StylePredictionEngine::Result style_prediction_result;
+        if (s_style_prediction_engine->Process(style_image, style_prediction_result) != StylePredictionEngine::kRetOk) {
+            return -1;
+        }
+        std::copy(style_prediction_result.styleBottleneck, style_prediction_result.styleBottleneck + style_bottleneck.size(), style_bottleneck.begin());
+    }
+
+    std::lock_guard<std::mutex> lock(s_style_bottleneck_cache_mutex);
+    s_style_bottleneck_list[style_filename] = style_bottleneck;
+    if (!is_found) {
+        s_style_bottleneck_cache[hash] = style_bottleneck;
+        s_style_bottleneck_cache_dirty = true;
+    }
+    return 0;
+}
+
+static int32_t CalculateStyleBottleneck(std::string styleFilename)
+{
+    StyleBottleneck style_bottleneck;
+    if (GetStyleBottleneck(styleFilename, style_bottleneck) != 0) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(s_style_prediction_mutex);
     for (int32_t i = 0; i < StylePredictionEngine::SIZE_STYLE_BOTTLENECK; i++) {
-        s_style_bottleneck[i] = style_prediction_result.styleBottleneck[i];
+        s_style_bottleneck[i] = style_bottleneck[i];
     }
     s_style_bottleneck_updated = true;
     return 0;
 }
 
+static void PrecomputeThread()
+{
+    /* Calculate style bottleneck for all style images in advance, so that switching style costs nothing */
+    std::vector<cv::String> path_list;
+    cv::glob(s_work_dir + "/style/*.jpg", path_list);
+    for (const auto& path : path_list) {
+        if (s_precompute_exit) break;
+        std::string filename = path.substr(path.find_last_of("/\\") + 1);
+        StyleBottleneck style_bottleneck;
+        GetStyleBottleneck(filename, style_bottleneck);
+    }
+    SaveStyleBottleneckCache();
+}
+
+static void StopPrecomputeThread()
+{
+    if (!s_precompute_thread.joinable()) return;
+    s_precompute_exit = true;
+    s_precompute_thread.join();
+}
+
+static void UpdateMergedStyleBottleneck(const cv::Mat& mat)
+{
+    constexpr float ratio = 0.5f;
+    std::lock_guard<std::mutex> lock(s_style_prediction_mutex);
+    StylePredictionEngine::Result style_prediction_result;
+    if (s_style_prediction_engine->Process(mat, style_prediction_result) != StylePredictionEngine::kRetOk) {
+        return;
+    }
+
+    /* Write to the buffer not in use, then publish it */
+    int32_t index_back = 1 - s_merged_style_bottleneck_index.load();
+    for (int32_t i = 0; i < StylePredictionEngine::SIZE_STYLE_BOTTLENECK; i++) {
+        s_merged_style_bottleneck[index_back][i] = ratio * style_prediction_result.styleBottleneck[i] + (1 - ratio) * s_style_bottleneck[i];
+    }
+    s_merged_style_bottleneck_index.store(index_back);
+}
+
+static void WorkerThread()
+{
+    while (true) {
+        cv::Mat mat;
+        {
+            std::unique_lock<std::mutex> lock(s_worker_mutex);
+            s_worker_cv.wait(lock, [] { return s_worker_exit || !s_worker_mat.empty(); });
+            if (s_worker_exit) break;
+            mat = s_worker_mat;
+            s_worker_mat = cv::Mat();
+        }
+        UpdateMergedStyleBottleneck(mat);
+        s_worker_busy = false;
+    }
+}
+
+static bool RequestMergedStyleBottleneck(const cv::Mat& mat)
+{
+    /* Do not wait. The request is retried in the next frame if the worker is still busy */
+    if (s_worker_busy) return false;
+    s_worker_busy = true;
+    {
+        std::lock_guard<std::mutex> lock(s_worker_mutex);
+        s_worker_mat = mat.clone();
+    }
+    s_worker_cv.notify_one();
+    return true;
+}
+
+static void StopWorkerThread()
+{
+    if (!s_worker_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(s_worker_mutex);
+        s_worker_exit = true;
+    }
+    s_worker_cv.notify_one();
+    s_worker_thread.join();
+}
+
 int32_t ImageProcessor::Initialize(const InputParam& input_param)
 {
     if (s_style_prediction_engine || s_style_transfer_engine) {
@@ -73,25 +304,81 @@ int32_t ImageProcessor::Initialize(const InputParam& input_param)
 
     s_work_dir = input_param.work_dir;
 
+    /* The two engines don't depend on each other, so they can be initialized (model load + session create) at the same time */
+    const auto& t_startup0 = std::chrono::steady_clock::now();
+    int32_t ret_style_prediction = StylePredictionEngine::kRetErr;
+    double time_style_prediction = 0;
     s_style_prediction_engine.reset(new StylePredictionEngine());
-    if (s_style_prediction_engine->Initialize(input_param.work_dir, input_param.num_threads) != StylePredictionEngine::kRetOk) {
-        s_style_prediction_engine->Finalize();
-        s_style_prediction_engine.reset();
-        return -1;
+    auto initialize_style_prediction = [&input_param, &ret_style_prediction, &time_style_prediction]() {
+        const auto& t0 = std::chrono::steady_clock::now();
+        ret_style_prediction = s_style_prediction_engine->Initialize(input_param.work_dir, input_param.num_threads);
+        const auto& t1 = std::chrono::steady_clock::now();
+        time_style_prediction = static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0;
+    };
+    std::thread initialize_thread;
+    if (kIsParallelInitialize) {
+        initialize_thread = std::thread(initialize_style_prediction);
+    } else {
+        initialize_style_prediction();
     }
 
+    const auto& t_style_transfer0 = std::chrono::steady_clock::now();
     s_style_transfer_engine.reset(new StyleTransferEngine());
-    if (s_style_transfer_engine->Initialize(input_param.work_dir, input_param.num_threads) != StyleTransferEngine::kRetOk) {
+    int32_t ret_style_transfer = s_style_transfer_engine->Initialize(input_param.work_dir, input_param.num_threads, kNumTileSession);
+    const auto& t_style_transfer1 = std::chrono::steady_clock::now();
+    if (initialize_thread.joinable()) initialize_thread.join();
+
+    if (ret_style_prediction != StylePredictionEngine::kRetOk || ret_style_transfer != StyleTransferEngine::kRetOk) {
+        s_style_prediction_engine->Finalize();
+        s_style_prediction_engine.reset();
         s_style_transfer_engine->Finalize();
         s_style_transfer_engine.reset();
         return -1;
     }
 
+    const auto& t_cache0 = std::chrono::steady_clock::now();
+    LoadStyleBottleneckCache();
+    const auto& t_cache1 = std::chrono::steady_clock::now();
+    PRINT("Startup: style prediction engine = %.3lf [msec]\n", time_style_prediction);
+    PRINT("Startup: style transfer engine = %.3lf [msec]\n", static_cast<std::chrono::duration<double>>(t_style_transfer1 - t_style_transfer0).count() * 1000.0);
+    PRINT("Startup: style bottleneck cache = %.3lf [msec]\n", static_cast<std::chrono::duration<double>>(t_cache1 - t_cache0).count() * 1000.0);
+    PRINT("Startup: total = %.3lf [msec] (%s)\n", static_cast<std::chrono::duration<double>>(t_cache1 - t_startup0).count() * 1000.0, kIsParallelInitialize ? "parallel" : "sequential");
     ImageProcessor::Command(0);
+    s_precompute_exit = false;
+    s_precompute_thread = std::thread(PrecomputeThread);
+
+    /* Use the style bottleneck as it is until the first merged style bottleneck is calculated */
+    for (int32_t i = 0; i < StylePredictionEngine::SIZE_STYLE_BOTTLENECK; i++) {
+        s_merged_style_bottleneck[0][i] = s_style_bottleneck[i];
+    }
+    s_merged_style_bottleneck_index = 0;
+    s_worker_exit = false;
+    s_worker_busy = false;
+    s_worker_thread = std::thread(WorkerThread);
 
     return 0;
 }
 
+int32_t ImageProcessor::Warmup(int32_t iterations)
+{
+    if (!s_style_prediction_engine || !s_style_transfer_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+
+    {
+        /* The style prediction engine may be used by the background threads */
+        std::lock_guard<std::mutex> lock(s_style_prediction_mutex);
+        if (s_style_prediction_engine->Warmup(iterations) != StylePredictionEngine::kRetOk) {
+            return -1;
+        }
+    }
+    if (s_style_transfer_engine->Warmup(iterations) != StyleTransferEngine::kRetOk) {
+        return -1;
+    }
+    return 0;
+}
+
 int32_t ImageProcessor::Finalize(void)
 {
     if (!s_style_prediction_engine || !s_style_transfer_engine) {
@@ -99,6 +386,10 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
+    StopWorkerThread();
+    StopPrecomputeThread();
+    SaveStyleBottleneckCache();
+
     if (s_style_prediction_engine->Finalize() != StylePredictionEngine::kRetOk) {
         return -1;
     }
@@ -122,7 +413,7 @@ int32_t ImageProcessor::Command(int32_t cmd)
     switch (cmd) {
     case 0:
         s_current_image_file_index++;
-        if (s_current_image_file_index > 30) s_current_image_file_index = 30;
+        if (s_current_image_file_index > kNumStyleImage - 1) s_current_image_file_index = kNumStyleImage - 1;
         break;
     case 1:
         s_current_image_file_index--;
@@ -131,6 +422,11 @@ int32_t ImageProcessor::Command(int32_t cmd)
     case 2:
         s_current_image_file_index = 0;
         break;
+    case 3:
+        /* Toggle full resolution (tiled) mode. Style is not changed */
+        s_is_tiled_mode = !s_is_tiled_mode;
+        PRINT("Tiled mode: %s\n", s_is_tiled_mode ? "ON" : "OFF");
+        return 0;
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
         return -1;
@@ -150,19 +446,29 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
     }
 
     constexpr int32_t INTERVAL_TO_CALCULATE_CONTENT_BOTTLENECK = 10; // to increase FPS (no need to do this every frame)
-    static float s_merged_style_bottleneck[StylePredictionEngine::SIZE_STYLE_BOTTLENECK];
     static int32_t s_cnt = 0;
+    static bool s_is_update_requested = false;
     if (s_cnt++ % INTERVAL_TO_CALCULATE_CONTENT_BOTTLENECK == 0 || s_style_bottleneck_updated) {
-        constexpr float ratio = 0.5f;
-        StylePredictionEngine::Result style_prediction_result;
-        s_style_prediction_engine->Process(mat, style_prediction_result);
-        for (int32_t i = 0; i < StylePredictionEngine::SIZE_STYLE_BOTTLENECK; i++) {
-            s_merged_style_bottleneck[i] = ratio * style_prediction_result.styleBottleneck[i] + (1 - ratio) * s_style_bottleneck[i];
-        }
+        s_is_update_requested = true;
+        s_style_bottleneck_updated = false;
     }
 
+    /* Use the latest completed merged style bottleneck. It's updated by the worker thread */
+    const float* merged_style_bottleneck = s_merged_style_bottleneck[s_merged_style_bottleneck_index.load()];
     StyleTransferEngine::Result style_transfer_result;
-    s_style_transfer_engine->Process(mat, s_merged_style_bottleneck, StylePredictionEngine::SIZE_STYLE_BOTTLENECK, style_transfer_result);
+    if (s_is_tiled_mode) {
+        if (s_style_transfer_engine->ProcessTiled(mat, merged_style_bottleneck, StylePredictionEngine::SIZE_STYLE_BOTTLENECK, style_transfer_result) != StyleTransferEngine::kRetOk) {
+            return -1;
+        }
+    } else {
+        if (s_style_transfer_engine->Process(mat, merged_style_bottleneck, StylePredictionEngine::SIZE_STYLE_BOTTLENECK, style_transfer_result) != StyleTransferEngine::kRetOk) {
+            return -1;
+        }
+    }
+
+    if (s_is_update_requested && RequestMergedStyleBottleneck(mat)) {
+        s_is_update_requested = false;
+    }
 
     DrawFps(style_transfer_result.image, style_transfer_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 
@@ -38,13 +38,55 @@
 
 
 /*** Function ***/
-int32_t StyleTransferEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
+/* Linear ramp in the area overlapping with the neighbor tiles. Weights of two overlapping tiles sum up to 1 */
+static std::vector<float> CreateFeatherWeight(const std::vector<int32_t>& pos_list, int32_t index, int32_t tile_size)
+{
+    std::vector<float> weight_list(tile_size, 1.0f);
+    const int32_t pos = pos_list[index];
+    if (index > 0) {
+        const int32_t ramp = pos_list[index - 1] + tile_size - pos;
+        for (int32_t i = 0; i < ramp; i++) {
+            weight_list[i] = (std::min)(weight_list[i], (i + 0.5f) / ramp);
+        }
+    }
+    if (index < static_cast<int32_t>(pos_list.size()) - 1) {
+        const int32_t ramp = pos + tile_size - pos_list[index + 1];
+        for (int32_t i = 0; i < ramp; i++) {
+            weight_list[tile_size - 1 - i] = (std::min)(weight_list[tile_size - 1 - i], (i + 0.5f) / ramp);
+        }
+    }
+    return weight_list;
+}
+
+
+int32_t StyleTransferEngine::Initialize(const std::string& work_dir, const int32_t num_threads, const int32_t num_tile_session)
 {
     /* Set model information */
     std::string model_filename = work_dir + "/model/" + MODEL_NAME;
 
+    if (CreateSession(model_filename, num_threads, inference_helper_, input_tensor_info_list_, output_tensor_info_list_) != kRetOk) {
+        return kRetErr;
+    }
+
+    /* Create additional sessions to process tiles in parallel. Threads are shared among sessions */
+    tile_session_list_.clear();
+    const int32_t num_threads_tile_session = (std::max)(1, num_threads / (std::max)(1, num_tile_session));
+    for (int32_t i = 1; i < num_tile_session; i++) {
+        TileSession tile_session;
+        if (CreateSession(model_filename, num_threads_tile_session, tile_session.inference_helper, tile_session.input_tensor_info_list, tile_session.output_tensor_info_list) != kRetOk) {
+            PRINT_E("Failed to create tile session(%d)\n", i);
+            break;
+        }
+        tile_session_list_.push_back(std::move(tile_session));
+    }
+
+    return kRetOk;
+}
+
+int32_t StyleTransferEngine::CreateSession(const std::string& model_filename, const int32_t num_threads, std::unique_ptr<InferenceHelper>& inference_helper, std::vector<InputTensorInfo>& input_tensor_info_list, std::vector<OutputTensorInfo>& output_tensor_info_list)
+{
     /* Set input tensor info */
-    input_tensor_info_list_.clear();
+    input_tensor_info_list.clear();
     InputTensorInfo input_tensor_info(INPUT_IMAGE_NAME, TENSORTYPE, IS_NCHW);
     input_tensor_info.tensor_dims = INPUT_IMAGE_DIMS;
     input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
@@ -54,7 +96,7 @@ int32_t StyleTransferEngine::Initialize(const std::string& work_dir, const int32
     input_tensor_info.normalize.norm[0] = 1.0f;
     input_tensor_info.normalize.norm[1] = 1.0f;
     input_tensor_info.normalize.norm[2] = 1.0f;
-    input_tensor_info_list_.push_back(input_tensor_info);
+    input_tensor_info_list.push_back(input_tensor_info);
     InputTensorInfo input_tensor_info_style(INPUT_STYLE_NAME, TENSORTYPE, IS_NCHW);
     input_tensor_info_style.tensor_dims = INPUT_STYLE_DIMS;
     input_tensor_info_style.data_type = InputTensorInfo::kDataTypeBlobNhwc;
@@ -64,24 +106,24 @@ int32_t StyleTransferEngine::Initialize(const std::string& work_dir, const int32
     input_tensor_info_style.normalize.norm[0] = 1.0f;
     input_tensor_info_style.normalize.norm[1] = 1.0f;
     input_tensor_info_style.normalize.norm[2] = 1.0f;
-    input_tensor_info_list_.push_back(input_tensor_info_style);
+    input_tensor_info_list.push_back(input_tensor_info_style);
 
     /* Set output tensor info */
-    output_tensor_info_list_.clear();
-    output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME, TENSORTYPE));
+    output_tensor_info_list.clear();
+    output_tensor_info_list.push_back(OutputTensorInfo(OUTPUT_NAME, TENSORTYPE));
 
     /* Create and Initialize Inference Helper */
-    inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kMnn));
+    inference_helper.reset(InferenceHelper::Create(InferenceHelper::kMnn));
 
-    if (!inference_helper_) {
+    if (!inference_helper) {
         return kRetErr;
     }
-    if (inference_helper_->SetNumThreads(num_threads) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
+    if (inference_helper->SetNumThreads(num_threads) != InferenceHelper::kRetOk) {
+        inference_helper.reset();
         return kRetErr;
     }
-    if (inference_helper_->Initialize(model_filename, input_tensor_info_list_, output_tensor_info_list_) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
+    if (inference_helper->Initialize(model_filename, input_tensor_info_list, output_tensor_info_list) != InferenceHelper::kRetOk) {
+        inference_helper.reset();
         return kRetErr;
     }
 
@@ -95,10 +137,39 @@ int32_t StyleTransferEngine::Finalize()
         return kRetErr;
     }
     inference_helper_->Finalize();
+    for (auto& tile_session : tile_session_list_) {
+        tile_session.inference_helper->Finalize();
+    }
+    tile_session_list_.clear();
     return kRetOk;
 }
 
 
+int32_t StyleTransferEngine::Warmup(int32_t iterations)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    const std::vector<float> style_bottleneck(input_tensor_info_list_[1].GetElementNum(), 0.0f);
+    bool is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth(), input_tensor_info.GetHeight(), iterations, [this, &style_bottleneck](const cv::Mat& mat) {
+        Result result;
+        return Process(mat, style_bottleneck.data(), static_cast<int32_t>(style_bottleneck.size()), result) == kRetOk;
+    });
+
+    /* The image for tiled mode has as many tiles as the sessions, so that all the tile sessions are warmed up */
+    const int32_t num_session = static_cast<int32_t>(tile_session_list_.size()) + 1;
+    if (is_ok && num_session > 1) {
+        is_ok = CommonHelper::RunWarmup(input_tensor_info.GetWidth() * num_session, input_tensor_info.GetHeight(), iterations, [this, &style_bottleneck](const cv::Mat& mat) {
+            Result result;
+            return ProcessTiled(mat, style_bottleneck.data(), static_cast<int32_t>(style_bottleneck.size()), result) == kRetOk;
+        });
+    }
+    return is_ok ? kRetOk : kRetErr;
+}
+
+
 int32_t StyleTransferEngine::Process(const cv::Mat& original_mat, const float styleBottleneck[], const int32_t lengthStyleBottleneck, Result& result)
 {
     if (!inference_helper_) {
@@ -160,3 +231,140 @@ int32_t StyleTransferEngine::Process(const cv::Mat& original_mat, const float st
     return kRetOk;
 }
 
+int32_t StyleTransferEngine::ProcessTile(InferenceHelper* inference_helper, std::vector<InputTensorInfo>& input_tensor_info_list, std::vector<OutputTensorInfo>& output_tensor_info_list,
+    const cv::Mat& original_mat, const cv::Rect& tile_rect, const float styleBottleneck[], cv::Mat& out_mat)
+{
+    InputTensorInfo& input_tensor_info = input_tensor_info_list[0];
+    int32_t crop_x = tile_rect.x;
+    int32_t crop_y = tile_rect.y;
+    int32_t crop_w = tile_rect.width;
+    int32_t crop_h = tile_rect.height;
+    cv::Mat img_src = cv::Mat::zeros(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
+    /* Tile is the same size as the model input except when the image is smaller than it */
+    CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
+
+    input_tensor_info.data = img_src.data;
+    input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
+    input_tensor_info.image_info.width = img_src.cols;
+    input_tensor_info.image_info.height = img_src.rows;
+    input_tensor_info.image_info.channel = img_src.channels();
+    input_tensor_info.image_info.crop_x = 0;
+    input_tensor_info.image_info.crop_y = 0;
+    input_tensor_info.image_info.crop_width = img_src.cols;
+    input_tensor_info.image_info.crop_height = img_src.rows;
+    input_tensor_info.image_info.is_bgr = false;
+    input_tensor_info.image_info.swap_color = false;
+
+    InputTensorInfo& inputTensorInfoBottleneck = input_tensor_info_list[1];
+    inputTensorInfoBottleneck.data = const_cast<float*>(styleBottleneck);
+    if (inference_helper->PreProcess(input_tensor_info_list) != InferenceHelper::kRetOk) {
+        return kRetErr;
+    }
+    if (inference_helper->Process(output_tensor_info_list) != InferenceHelper::kRetOk) {
+        return kRetErr;
+    }
+
+    /* Copy the output because the tensor is overwritten by the next tile */
+    cv::Mat out_mat_fp(cv::Size(output_tensor_info_list[0].tensor_dims[2], output_tensor_info_list[0].tensor_dims[1]), CV_32FC3, const_cast<float*>(output_tensor_info_list[0].GetDataAsFloat()));
+    cv::resize(out_mat_fp, out_mat, tile_rect.size());
+    return kRetOk;
+}
+
+int32_t StyleTransferEngine::ProcessTiled(const cv::Mat& original_mat, const float styleBottleneck[], const int32_t lengthStyleBottleneck, Result& result)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    /*** PreProcess ***/
+    const auto& t_pre_process0 = std::chrono::steady_clock::now();
+    const int32_t tile_w = (std::min)(input_tensor_info_list_[0].GetWidth(), original_mat.cols);
+    const int32_t tile_h = (std::min)(input_tensor_info_list_[0].GetHeight(), original_mat.rows);
+    const std::vector<int32_t> pos_x_list = CommonHelper::CalculateTilePosition(original_mat.cols, tile_w, tile_overlap_);
+    const std::vector<int32_t> pos_y_list = CommonHelper::CalculateTilePosition(original_mat.rows, tile_h, tile_overlap_);
+    std::vector<cv::Rect> tile_rect_list;
+    for (int32_t pos_y : pos_y_list) {
+        for (int32_t pos_x : pos_x_list) {
+            tile_rect_list.push_back(cv::Rect(pos_x, pos_y, tile_w, tile_h));
+        }
+    }
+    const int32_t num_tile = static_cast<int32_t>(tile_rect_list.size());
+    std::vector<cv::Mat> tile_out_list(num_tile);
+    const auto& t_pre_process1 = std::chrono::steady_clock::now();
+
+    /*** Inference (including pre-process of each tile) ***/
+    /* Each session processes every num_session-th tile. All tiles use the same style bottleneck */
+    const auto& t_inference0 = std::chrono::steady_clock::now();
+    const int32_t num_session = static_cast<int32_t>(tile_session_list_.size()) + 1;
+    std::vector<int32_t> ret_list(num_session, kRetOk);
+#pragma omp parallel for num_threads(num_session)
+    for (int32_t session_index = 0; session_index < num_session; session_index++) {
+        for (int32_t i = session_index; i < num_tile; i += num_session) {
+            int32_t ret;
+            if (session_index == 0) {
+                ret = ProcessTile(inference_helper_.get(), input_tensor_info_list_, output_tensor_info_list_, original_mat, tile_rect_list[i], styleBottleneck, tile_out_list[i]);
+            } else {
+                TileSession& tile_session = tile_session_list_[session_index - 1];
+                ret = ProcessTile(tile_session.inference_helper.get(), tile_session.input_tensor_info_list, tile_session.output_tensor_info_list, original_mat, tile_rect_list[i], styleBottleneck, tile_out_list[i]);
+            }
+            if (ret != kRetOk) {
+                ret_list[session_index] = kRetErr;
+                break;
+            }
+        }
+    }
+    for (int32_t ret : ret_list) {
+        if (ret != kRetOk) return kRetErr;
+    }
+    const auto& t_inference1 = std::chrono::steady_clock::now();
+
+    /*** PostProcess ***/
+    /* Feather-blend the seams */
+    const auto& t_post_process0 = std::chrono::steady_clock::now();
+    cv::Mat acc_mat = cv::Mat::zeros(original_mat.size(), CV_32FC3);
+    cv::Mat weight_sum_mat = cv::Mat::zeros(original_mat.size(), CV_32FC1);
+    for (int32_t tile_y = 0; tile_y < static_cast<int32_t>(pos_y_list.size()); tile_y++) {
+        const std::vector<float> weight_y_list = CreateFeatherWeight(pos_y_list, tile_y, tile_h);
+        for (int32_t tile_x = 0; tile_x < static_cast<int32_t>(pos_x_list.size()); tile_x++) {
+            const std::vector<float> weight_x_list = CreateFeatherWeight(pos_x_list, tile_x, tile_w);
+            const int32_t tile_index = tile_y * static_cast<int32_t>(pos_x_list.size()) + tile_x;
+            const cv::Rect& tile_rect = tile_rect_list[tile_index];
+            const cv::Mat& tile_out = tile_out_list[tile_index];
+#pragma omp parallel for
+            for (int32_t y = 0; y < tile_h; y++) {
+                const float* src = tile_out.ptr<float>(y);
+                float* dst = acc_mat.ptr<float>(tile_rect.y + y) + tile_rect.x * 3;
+                float* dst_weight = weight_sum_mat.ptr<float>(tile_rect.y + y) + tile_rect.x;
+                for (int32_t x = 0; x < tile_w; x++) {
+                    const float weight = weight_y_list[y] * weight_x_list[x];
+                    dst[x * 3 + 0] += src[x * 3 + 0] * weight;
+                    dst[x * 3 + 1] += src[x * 3 + 1] * weight;
+                    dst[x * 3 + 2] += src[x * 3 + 2] * weight;
+                    dst_weight[x] += weight;
+                }
+            }
+        }
+    }
+    cv::Mat out_mat(original_mat.size(), CV_8UC3);
+#pragma omp parallel for
+    for (int32_t y = 0; y < out_mat.rows; y++) {
+        const float* src = acc_mat.ptr<float>(y);
+        const float* src_weight = weight_sum_mat.ptr<float>(y);
+        uint8_t* dst = out_mat.ptr<uint8_t>(y);
+        for (int32_t x = 0; x < out_mat.cols; x++) {
+            const float scale = 255.0f / src_weight[x];
+            dst[x * 3 + 0] = cv::saturate_cast<uint8_t>(src[x * 3 + 0] * scale);
+            dst[x * 3 + 1] = cv::saturate_cast<uint8_t>(src[x * 3 + 1] * scale);
+            dst[x * 3 + 2] = cv::saturate_cast<uint8_t>(src[x * 3 + 2] * scale);
+        }
+    }
+    const auto& t_post_process1 = std::chrono::steady_clock::now();
+
+    /* Return the results */
+    result.image = out_mat;
+    result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
+    result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
+    result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
+
+    return kRetOk;
+}
@@ -33,17 +33,39 @@ public:
     } Result;
 
 public:
-    StyleTransferEngine() {}
+    StyleTransferEngine() : tile_overlap_(kDefaultTileOverlap) {}
     ~StyleTransferEngine() {}
-    int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
+    /* num_tile_session: number of sessions to run tiles in parallel (ProcessTiled only) */
+    int32_t Initialize(const std::string& work_dir, const int32_t num_threads, const int32_t num_tile_session = 1);
     int32_t Finalize(void);
+    /* Warm up Process and ProcessTiled (all the tile sessions) */
+    int32_t Warmup(int32_t iterations);
     int32_t Process(const cv::Mat& original_mat, const float styleBottleneck[], const int lengthStyleBottleneck, Result& result);
+    /* Process the image in full resolution by splitting it into overlapping model-sized tiles */
+    int32_t ProcessTiled(const cv::Mat& original_mat, const float styleBottleneck[], const int lengthStyleBottleneck, Result& result);
+    void SetTileOverlap(int32_t tile_overlap) { tile_overlap_ = tile_overlap; }
 
+private:
+    typedef struct TileSession_ {
+        std::unique_ptr<InferenceHelper> inference_helper;
+        std::vector<InputTensorInfo> input_tensor_info_list;
+        std::vector<OutputTensorInfo> output_tensor_info_list;
+    } TileSession;
+
+    static constexpr int32_t kDefaultTileOverlap = 64;
+
+private:
+    int32_t CreateSession(const std::string& model_filename, const int32_t num_threads, std::unique_ptr<InferenceHelper>& inference_helper, std::vector<InputTensorInfo>& input_tensor_info_list, std::vector<OutputTensorInfo>& output_tensor_info_list);
+    int32_t ProcessTile(InferenceHelper* inference_helper, std::vector<InputTensorInfo>& input_tensor_info_list, std::vector<OutputTensorInfo>& output_tensor_info_list,
+        const cv::Mat& original_mat, const cv::Rect& tile_rect, const float styleBottleneck[], cv::Mat& out_mat);
 
 private:
     std::unique_ptr<InferenceHelper> inference_helper_;
     std::vector<InputTensorInfo> input_tensor_info_list_;
     std::vector<OutputTensorInfo> output_tensor_info_list_;
+
+    std::vector<TileSession> tile_session_list_;   /* additional sessions. The main session above is also used for tiles */
+    int32_t tile_overlap_;
 };
 
 #endif